@@ -0,0 +1,149 @@
+#include "../../src/definitions.h"
+#include "../../src/util/bitwise.h"
+#include "../../src/util/thread_pool.h"
+#include "../../src/video/pixel_kernels.h"
+#include "../../src/video/tile.h"
+#include "../../src/video/upscale.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+/* Keeps results observable so the compiler can't drop the work */
+static uint checksum = 0;
+
+template <typename Fn>
+static void bench(const char* name, uint iterations, Fn&& fn) {
+    /* Warm up caches and branch predictors before timing */
+    for (uint i = 0; i < iterations / 10 + 1; i++) { fn(i); }
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint i = 0; i < iterations; i++) { fn(i); }
+    auto end = std::chrono::steady_clock::now();
+
+    double ns = std::chrono::duration<double, std::nano>(end - start).count();
+    printf("%-40s %10.1f ns/iter\n", name, ns / iterations);
+}
+
+/* One scanline drawn the way Video used to: every pixel splits its bits out
+ * of the tile data and goes through a switch to find its palette shade */
+static void reference_line(const u8* tile_data, const u8* tile_ids, u8 palette, u8* shades) {
+    using bitwise::bit_value;
+    using bitwise::compose_bits;
+
+    for (uint x = 0; x < GAMEBOY_WIDTH; x++) {
+        const u8* line = &tile_data[tile_ids[x / TILE_WIDTH_PX] * TILE_BYTES];
+        uint bit = 7 - (x % TILE_WIDTH_PX);
+        u8 index = compose_bits(bit_value(line[1], bit), bit_value(line[0], bit));
+
+        switch (index) {
+            case 0: shades[x] = compose_bits(bit_value(palette, 1), bit_value(palette, 0)); break;
+            case 1: shades[x] = compose_bits(bit_value(palette, 3), bit_value(palette, 2)); break;
+            case 2: shades[x] = compose_bits(bit_value(palette, 5), bit_value(palette, 4)); break;
+            default: shades[x] = compose_bits(bit_value(palette, 7), bit_value(palette, 6)); break;
+        }
+    }
+}
+
+static void bench_scanlines() {
+    const uint tiles_per_line = GAMEBOY_WIDTH / TILE_WIDTH_PX;
+
+    std::mt19937 rng(42);
+    std::vector<u8> tile_data(TILE_DATA_BYTES);
+    for (u8& byte : tile_data) { byte = static_cast<u8>(rng()); }
+
+    std::vector<u8> tile_ids(tiles_per_line * 64);
+    for (u8& id : tile_ids) { id = static_cast<u8>(rng()); }
+
+    std::vector<u8> decoded(TILE_COUNT * TILE_HEIGHT_PX * TILE_WIDTH_PX);
+    pixel_kernels::decode_2bpp_lines(tile_data.data(), TILE_COUNT * TILE_HEIGHT_PX, decoded.data());
+
+    u8 indices[GAMEBOY_WIDTH];
+    u8 shades[GAMEBOY_WIDTH];
+
+    printf("Scanline (160 px) decode + palette, kernels: %s\n", pixel_kernels::instruction_set());
+
+    bench("per-pixel bit_value + palette switch", 200000, [&](uint i) {
+        reference_line(tile_data.data(), &tile_ids[(i % 64) * tiles_per_line], static_cast<u8>(i), shades);
+        checksum += shades[i % GAMEBOY_WIDTH];
+    });
+
+    bench("decode per tile + apply_palette", 200000, [&](uint i) {
+        const u8* ids = &tile_ids[(i % 64) * tiles_per_line];
+        for (uint t = 0; t < tiles_per_line; t++) {
+            const u8* line = &tile_data[ids[t] * TILE_BYTES];
+            pixel_kernels::decode_2bpp_line(line[0], line[1], &indices[t * TILE_WIDTH_PX]);
+        }
+        pixel_kernels::apply_palette(indices, GAMEBOY_WIDTH, static_cast<u8>(i), shades);
+        checksum += shades[i % GAMEBOY_WIDTH];
+    });
+
+    bench("decoded tile lines + apply_palette", 200000, [&](uint i) {
+        const u8* ids = &tile_ids[(i % 64) * tiles_per_line];
+        for (uint t = 0; t < tiles_per_line; t++) {
+            std::memcpy(&indices[t * TILE_WIDTH_PX], &decoded[ids[t] * TILE_HEIGHT_PX * TILE_WIDTH_PX], TILE_WIDTH_PX);
+        }
+        pixel_kernels::apply_palette(indices, GAMEBOY_WIDTH, static_cast<u8>(i), shades);
+        checksum += shades[i % GAMEBOY_WIDTH];
+    });
+
+    bench("decode_2bpp_lines, all 384 tiles", 2000, [&](uint i) {
+        tile_data[i % TILE_DATA_BYTES] ^= 1;
+        pixel_kernels::decode_2bpp_lines(tile_data.data(), TILE_COUNT * TILE_HEIGHT_PX, decoded.data());
+        checksum += decoded[i % decoded.size()];
+    });
+}
+
+static void bench_upscalers() {
+    /* A frame with the long edges and flat areas typical of tile graphics */
+    FrameBuffer frame(GAMEBOY_WIDTH, GAMEBOY_HEIGHT);
+    std::mt19937 rng(42);
+    for (uint y = 0; y < GAMEBOY_HEIGHT; y++) {
+        for (uint x = 0; x < GAMEBOY_WIDTH; x++) {
+            uint shade = ((x / 6 + y / 9) + (rng() % 7 == 0)) % 4;
+            frame.set_pixel(x, y, static_cast<Color>(shade));
+        }
+    }
+
+    const ShadeLut lut = {{ {224, 248, 208}, {136, 192, 112}, {52, 104, 86}, {8, 24, 32} }};
+
+    ThreadPool pool;
+
+    /* The largest whole factor that fits 3840x2160 is 15 */
+    const uint uhd_factor = std::min(3840 / GAMEBOY_WIDTH, 2160 / GAMEBOY_HEIGHT);
+
+    printf("\nUpscaling one frame, %u worker threads + caller\n", pool.size());
+
+    for (UpscaleFilter filter : { UpscaleFilter::Nearest, UpscaleFilter::Scale2x,
+                                  UpscaleFilter::Scale3x, UpscaleFilter::Xbr2x }) {
+        uint native = upscale::native_scale(filter);
+        uint uhd = uhd_factor - uhd_factor % native;
+
+        for (uint factor : { native == 1 ? 2 : native, uhd }) {
+            uint pitch = GAMEBOY_WIDTH * factor * 4;
+            std::vector<u8> pixels(pitch * GAMEBOY_HEIGHT * factor);
+            uint iterations = factor > 4 ? 200 : 2000;
+
+            for (ThreadPool* threads : { static_cast<ThreadPool*>(nullptr), &pool }) {
+                char name[64];
+                snprintf(name, sizeof(name), "%s x%u (%ux%u)%s", upscale::filter_name(filter), factor,
+                         GAMEBOY_WIDTH * factor, GAMEBOY_HEIGHT * factor, threads ? ", pool" : "");
+
+                bench(name, iterations, [&](uint i) {
+                    upscale::upscale(frame, filter, factor, lut, pixels.data(), pitch, threads);
+                    checksum += pixels[(i * 4099) % pixels.size()];
+                });
+            }
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    bench_scanlines();
+    bench_upscalers();
+
+    printf("(checksum %u)\n", checksum);
+    return 0;
+}
@@ -3,14 +3,43 @@
 #include "../../src/options.h"
 #include "../../src/definitions.h"
 #include "../../src/util/log.h"
+#include "../../src/video/ppu_compat.h"
 #include <string>
 #include <vector>
 
 struct CliOptions {
     Options options;
     std::string filename;
+    std::string filter; /* Upscaling filter name, for frontends that draw */
+    std::string audio_format = "s16"; /* Sample format asked of the audio device: s16 or f32 */
+    uint fast_forward = 2; /* Speed while fast-forwarding, 0 for uncapped */
+
+    std::string capture_path; /* Record frames here, "-" for stdout */
+    std::string capture_format = "y4m";
+    uint capture_every = 1;
+    std::string audio_path; /* Record sound to this WAV file */
+    uint frames = 0; /* Stop after this many frames, 0 to run until closed */
 };
 
+/* The number after a flag's '=', which must be all digits and at least
+ * minimum */
+static uint parse_flag_number(const std::string& flag, size_t value_start, uint minimum) {
+    std::string value = flag.substr(value_start);
+
+    bool valid = !value.empty() && value.size() <= 9
+        && value.find_first_not_of("0123456789") == std::string::npos;
+    if (!valid) {
+        fatal_error("Expected a number in %s", flag.c_str());
+    }
+
+    uint number = static_cast<uint>(std::stoul(value));
+    if (number < minimum) {
+        fatal_error("%s must be at least %u", flag.c_str(), minimum);
+    }
+
+    return number;
+}
+
 CliOptions get_cli_options(int argc, char* argv[]);
 CliOptions get_cli_options(int argc, char* argv[]) {
     if (argc < 2) {
@@ -30,6 +59,35 @@ CliOptions get_cli_options(int argc, char* argv[]) {
         else if (flag == "--whole-framebuffer") { cliOptions.options.show_full_framebuffer = true; }
         else if (flag == "--exit-on-infinite-jr") { cliOptions.options.exit_on_infinite_jr = true; }
         else if (flag == "--print-serial-output") { cliOptions.options.print_serial = true; }
+        else if (flag == "--render-thread") { cliOptions.options.render_thread = true; }
+        else if (flag == "--audio-thread") { cliOptions.options.audio_thread = true; }
+        else if (flag.rfind("--filter=", 0) == 0) { cliOptions.filter = flag.substr(9); }
+        else if (flag.rfind("--audio-format=", 0) == 0) { cliOptions.audio_format = flag.substr(15); }
+        else if (flag.rfind("--ppu=", 0) == 0) {
+            if (!ppu_compat::accuracy_from_name(flag.substr(6), cliOptions.options.ppu_accuracy)) {
+                fatal_error("Unknown PPU accuracy: %s", flag.substr(6).c_str());
+            }
+        }
+        else if (flag.rfind("--fast-forward=", 0) == 0) {
+            std::string speed = flag.substr(15);
+            if (speed == "max") { cliOptions.fast_forward = 0; }
+            else if (speed == "2" || speed == "4") { cliOptions.fast_forward = static_cast<uint>(std::stoul(speed)); }
+            else { fatal_error("Unknown fast-forward speed: %s", speed.c_str()); }
+        }
+        else if (flag.rfind("--audio-out=", 0) == 0) { cliOptions.audio_path = flag.substr(12); }
+        else if (flag.rfind("--capture=", 0) == 0) { cliOptions.capture_path = flag.substr(10); }
+        else if (flag.rfind("--capture-format=", 0) == 0) { cliOptions.capture_format = flag.substr(17); }
+        else if (flag.rfind("--capture-every=", 0) == 0) {
+            cliOptions.capture_every = parse_flag_number(flag, 16, 0);
+        }
+        else if (flag.rfind("--frames=", 0) == 0) {
+            cliOptions.frames = parse_flag_number(flag, 9, 0);
+        }
+        else if (flag.rfind("--render-every=", 0) == 0) {
+            /* An interval of 0 would render nothing unasked for, which only
+             * --headless can make sense of and already sets up itself */
+            cliOptions.options.render_interval = parse_flag_number(flag, 15, 1);
+        }
         else { fatal_error("Unknown flag: %s", flag.c_str()); }
     }
 
@@ -0,0 +1,90 @@
+#include "../../src/gameboy_prelude.h"
+#include "../../src/apu/wav_sink.h"
+#include "../../src/video/capture.h"
+#include "../../src/video/framebuffer.h"
+#include "../cli/cli.h"
+
+#include <cstdio>
+#include <memory>
+
+// Plain greyscale, indexed by shade (white to black)
+static const ShadeLut GREY_PALETTE = {{
+    {255, 255, 255},
+    {170, 170, 170},
+    { 85,  85,  85},
+    {  0,   0,   0},
+}};
+
+// Runs a ROM as fast as it will go with no window, optionally recording
+// frames: --capture=out.y4m, or --capture=- to pipe into an encoder, e.g.
+//   gbemu-headless rom.gb --frames=3600 --capture=- | ffmpeg -i - out.mp4
+// and sound with --audio-out=out.wav. Without that no sound is synthesised.
+int main(int argc, char* argv[]) {
+    CliOptions opts = get_cli_options(argc, argv);
+    auto rom = read_bytes(opts.filename);
+
+    std::unique_ptr<VideoCapture> capture;
+    const uint capture_every = opts.capture_every == 0 ? 1 : opts.capture_every;
+
+    if (!opts.capture_path.empty()) {
+        CaptureFormat format;
+        if (opts.capture_format == "y4m") { format = CaptureFormat::Y4m; }
+        else if (opts.capture_format == "rgb") { format = CaptureFormat::Rgb24; }
+        else { fatal_error("Unknown capture format: %s", opts.capture_format.c_str()); }
+
+        capture.reset(new VideoCapture(opts.capture_path, format, GREY_PALETTE, capture_every));
+
+        // Frames go to stdout, so keep logs off it
+        if (opts.capture_path == "-") {
+            opts.options.disable_logs = true;
+            log_set_level(LogLevel::Error);
+        }
+    }
+
+    std::unique_ptr<WavFileSink> audio;
+    if (!opts.audio_path.empty()) {
+        audio.reset(new WavFileSink(opts.audio_path));
+        opts.options.audio_sink = audio.get();
+    }
+
+    // Nothing is watching, so only draw the frames that get recorded
+    opts.options.headless = true;
+
+    Gameboy gameboy(rom, opts.options);
+    if (capture) { gameboy.request_frame(); }
+
+    u64 frames = 0;
+    u64 last_hash = 0;
+
+    while (opts.frames == 0 || frames < opts.frames) {
+        const FrameBuffer& fb = gameboy.run_frame();
+
+        if (capture) {
+            capture->add_frame(fb);
+            if ((frames + 1) % capture_every == 0) { gameboy.request_frame(); }
+        }
+        if (audio) { gameboy.flush_audio(); }
+        last_hash = fb.hash();
+        frames++;
+    }
+
+    fprintf(stderr, "frames: %llu, last frame hash: %016llx\n",
+            static_cast<unsigned long long>(frames), static_cast<unsigned long long>(last_hash));
+
+    if (capture) {
+        capture->finish();
+        fprintf(stderr, "captured: %llu, dropped: %llu\n",
+                static_cast<unsigned long long>(capture->frames_written()),
+                static_cast<unsigned long long>(capture->frames_dropped()));
+    }
+
+    if (audio) {
+        gameboy.wait_for_audio();
+        audio->finish();
+        fprintf(stderr, "audio: %llu samples recorded, %llu dropped\n",
+                static_cast<unsigned long long>(audio->frames_written()),
+                static_cast<unsigned long long>(audio->frames_dropped()));
+    }
+
+    return 0;
+}
@@ -1,28 +1,48 @@
 #include <SDL2/SDL.h>
 
 #include "../../src/gameboy_prelude.h"
+#include "../../src/apu/audio_buffer.h"
+#include "../../src/video/frame_exchange.h"
 #include "../../src/video/framebuffer.h"
+#include "../../src/video/upscale.h"
+#include "../../src/util/spsc_queue.h"
+#include "../../src/util/thread_pool.h"
 #include "../../platforms/cli/cli.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
 static const int SCALE = 3;
 
-// Classic DMG green palette
-struct RGBA { u8 r, g, b; };
-static constexpr RGBA GB_PALETTE[4] = {
+// One frame of the DMG's 4.194304 MHz clock: 70224 cycles, ~59.73 Hz
+static const std::chrono::nanoseconds FRAME_DURATION(16742706);
+
+struct KeyEvent {
+    SDL_Keycode key;
+    bool pressed;
+};
+
+// Classic DMG green palette, indexed by shade (white to black)
+static const ShadeLut GB_PALETTE = {{
     {155, 188,  15},  // White
     {139, 172,  15},  // Light gray
     { 48,  98,  48},  // Dark gray
     { 15,  56,  15},  // Black
-};
+}};
 
-static RGBA color_to_rgba(Color c) {
-    switch (c) {
-        case Color::White:     return GB_PALETTE[0];
-        case Color::LightGray: return GB_PALETTE[1];
-        case Color::DarkGray:  return GB_PALETTE[2];
-        case Color::Black:     return GB_PALETTE[3];
-    }
-    return GB_PALETTE[0];
+// Run on SDL's audio thread: pull what the emulator has made, padding any
+// shortfall with silence. 16-bit samples go straight through; float ones
+// are converted as they are copied out.
+static void audio_callback_s16(void* userdata, Uint8* stream, int len) {
+    auto* ring = static_cast<AudioBuffer*>(userdata);
+    ring->pop(reinterpret_cast<s16*>(stream), static_cast<size_t>(len) / (2 * sizeof(s16)));
+}
+
+static void audio_callback_f32(void* userdata, Uint8* stream, int len) {
+    auto* ring = static_cast<AudioBuffer*>(userdata);
+    ring->pop(reinterpret_cast<float*>(stream), static_cast<size_t>(len) / (2 * sizeof(float)));
 }
 
 static void handle_key(Gameboy& gb, SDL_Keycode key, bool pressed) {
@@ -47,6 +67,21 @@ int main(int argc, char* argv[]) {
     CliOptions opts = get_cli_options(argc, argv);
     auto rom = read_bytes(opts.filename);
 
+    // Optional CPU-side upscaling; otherwise the renderer scales the texture
+    // nearest-neighbour. Either way it is stretched to fit the window.
+    UpscaleFilter filter = UpscaleFilter::Nearest;
+    if (!opts.filter.empty() && !upscale::filter_from_name(opts.filter, filter)) {
+        fprintf(stderr, "Unknown filter: %s\n", opts.filter.c_str());
+        return 1;
+    }
+    const uint filter_scale = upscale::native_scale(filter);
+
+    if (opts.audio_format != "s16" && opts.audio_format != "f32") {
+        fprintf(stderr, "Unknown audio format: %s\n", opts.audio_format.c_str());
+        return 1;
+    }
+    const bool audio_float = opts.audio_format == "f32";
+
     if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO) != 0) {
         fprintf(stderr, "SDL_Init failed: %s\n", SDL_GetError());
         return 1;
@@ -70,20 +105,29 @@ int main(int argc, char* argv[]) {
     );
     SDL_RenderSetLogicalSize(renderer, GAMEBOY_WIDTH, GAMEBOY_HEIGHT);
 
-    // Streaming texture — one pixel per GB pixel, scaled by the renderer.
+    // Streaming texture — one pixel per GB pixel, or per upscaled pixel with
+    // a filter, scaled to the window by the renderer.
+    // RGBA32 is R, G, B, A in memory, matching FrameBuffer::to_rgba32.
     SDL_Texture* texture = SDL_CreateTexture(
         renderer,
-        SDL_PIXELFORMAT_RGB24,
+        SDL_PIXELFORMAT_RGBA32,
         SDL_TEXTUREACCESS_STREAMING,
-        GAMEBOY_WIDTH, GAMEBOY_HEIGHT
+        static_cast<int>(GAMEBOY_WIDTH * filter_scale),
+        static_cast<int>(GAMEBOY_HEIGHT * filter_scale)
     );
+    ThreadPool upscale_pool(filter_scale > 1 ? ThreadPool::default_threads() : 0);
 
-    // Audio: 44100 Hz stereo float, queued from the main thread.
+    // Audio: 44100 Hz stereo, 16-bit unless asked for float, pulled by
+    // SDL's audio thread from the ring the emulation thread fills. No allowed
+    // changes, so SDL converts if the device wants something else.
+    AudioBuffer audio_ring;
     SDL_AudioSpec desired = {};
     desired.freq     = 44100;
-    desired.format   = AUDIO_F32SYS;
+    desired.format   = audio_float ? AUDIO_F32SYS : AUDIO_S16SYS;
     desired.channels = 2;
     desired.samples  = 1024;
+    desired.callback = audio_float ? audio_callback_f32 : audio_callback_s16;
+    desired.userdata = &audio_ring;
     SDL_AudioSpec obtained = {};
     SDL_AudioDeviceID audio_dev = SDL_OpenAudioDevice(
         nullptr, 0, &desired, &obtained, 0
@@ -91,68 +135,126 @@ int main(int argc, char* argv[]) {
     if (audio_dev == 0) {
         fprintf(stderr, "SDL_OpenAudioDevice failed: %s\n", SDL_GetError());
     } else {
-        SDL_PauseAudioDevice(audio_dev, 0);
+        opts.options.audio_sink = &audio_ring;
     }
-    // Allow ~4 SDL buffer-lengths of queued audio before dropping samples.
-    const Uint32 audio_queue_limit = obtained.size * 4;
 
     Gameboy gameboy(rom, opts.options);
-    bool should_quit = false;
-
-    gameboy.run(
-        [&]() { return should_quit; },
-        [&](const FrameBuffer& fb) {
-            // --- Events ---
-            SDL_Event event;
-            while (SDL_PollEvent(&event)) {
-                if (event.type == SDL_QUIT) {
+
+    if (audio_dev != 0) {
+        // The device's clock and our frame pacing never quite agree; let the
+        // APU nudge its output rate to keep the ring from drifting.
+        gameboy.set_audio_rate_control(true);
+        SDL_PauseAudioDevice(audio_dev, 0);
+    }
+    double rate_min = 1.0;
+    double rate_max = 1.0;
+
+    FrameExchange frames;
+    SpscQueue<KeyEvent, 64> key_events;
+    std::atomic<bool> should_quit = {false};
+
+    // Emulation runs on its own thread, paced to the Game Boy's frame rate,
+    // and hands finished frames over without waiting. The main thread owns
+    // SDL: it forwards input and presents the newest frame at each vsync, so
+    // a slow present never holds up emulation.
+    // Holding Tab fast-forwards at the speed given by --fast-forward.
+    std::thread emulation([&]() {
+        auto next_frame = std::chrono::steady_clock::now();
+        uint speed = 1;
+
+        while (!should_quit.load(std::memory_order_relaxed)) {
+            const FrameBuffer& fb = gameboy.run_frame();
+
+            // --- Input ---
+            KeyEvent key;
+            while (key_events.try_pop(key)) {
+                if (key.key == SDLK_TAB) {
+                    speed = key.pressed ? opts.fast_forward : 1;
+                    gameboy.set_speed(speed);
+                    continue;
+                }
+                handle_key(gameboy, key.key, key.pressed);
+            }
+
+            frames.publish(fb);
+
+            // --- Audio ---
+            gameboy.flush_audio();
+            AudioTelemetry audio = gameboy.get_audio_telemetry();
+            rate_min = std::min(rate_min, audio.rate_ratio);
+            rate_max = std::max(rate_max, audio.rate_ratio);
+
+            // --- Pace ---
+            // After a long stall, start afresh rather than race to catch up.
+            auto now = std::chrono::steady_clock::now();
+            if (speed == 0) {
+                next_frame = now;
+                continue;
+            }
+            auto frame_duration = FRAME_DURATION / speed;
+            next_frame += frame_duration;
+            if (next_frame + frame_duration < now) next_frame = now;
+            std::this_thread::sleep_until(next_frame);
+        }
+    });
+
+    u64 shown_hash = 0;
+    bool shown_any = false;
+
+    while (!should_quit) {
+        // --- Events ---
+        SDL_Event event;
+        while (SDL_PollEvent(&event)) {
+            if (event.type == SDL_QUIT) {
+                should_quit = true;
+            } else if (event.type == SDL_KEYDOWN || event.type == SDL_KEYUP) {
+                bool down = (event.type == SDL_KEYDOWN);
+                if (down && event.key.keysym.sym == SDLK_ESCAPE) {
                     should_quit = true;
-                } else if (event.type == SDL_KEYDOWN || event.type == SDL_KEYUP) {
-                    bool down = (event.type == SDL_KEYDOWN);
-                    if (down && event.key.keysym.sym == SDLK_ESCAPE) {
-                        should_quit = true;
-                    }
-                    handle_key(gameboy, event.key.keysym.sym, down);
                 }
+                key_events.try_push({event.key.keysym.sym, down});
             }
+        }
 
-            // --- Render frame ---
+        // --- Render frame ---
+        // Convert straight into the texture's memory: no staging copy.
+        // Frames may have been dropped in between, so compare hashes with
+        // what the texture holds rather than trusting unchanged().
+        const FrameBuffer* fb = frames.take();
+        if (fb && (!shown_any || fb->hash() != shown_hash)) {
             void* pixels;
             int pitch;
             SDL_LockTexture(texture, nullptr, &pixels, &pitch);
-            for (uint y = 0; y < GAMEBOY_HEIGHT; ++y) {
-                u8* row = static_cast<u8*>(pixels) + y * pitch;
-                for (uint x = 0; x < GAMEBOY_WIDTH; ++x) {
-                    RGBA c = color_to_rgba(fb.get_pixel(x, y));
-                    u8* p  = row + x * 3;
-                    p[0] = c.r;
-                    p[1] = c.g;
-                    p[2] = c.b;
-                }
+            if (filter_scale > 1) {
+                upscale::upscale(*fb, filter, filter_scale, GB_PALETTE,
+                                 static_cast<u8*>(pixels), static_cast<uint>(pitch), &upscale_pool);
+            } else {
+                fb->to_rgba32(GB_PALETTE, static_cast<u8*>(pixels), static_cast<uint>(pitch));
             }
             SDL_UnlockTexture(texture);
-            SDL_RenderClear(renderer);
-            SDL_RenderCopy(renderer, texture, nullptr, nullptr);
-            SDL_RenderPresent(renderer);
-
-            // --- Queue audio ---
-            if (audio_dev != 0) {
-                AudioBuffer& buf = gameboy.get_audio_buffer();
-                if (buf.size() > 0) {
-                    if (SDL_GetQueuedAudioSize(audio_dev) < audio_queue_limit) {
-                        SDL_QueueAudio(
-                            audio_dev,
-                            buf.data(),
-                            static_cast<Uint32>(buf.size() * 2 * sizeof(float))
-                        );
-                    }
-                    buf.clear();
-                }
-            }
+            shown_hash = fb->hash();
+            shown_any = true;
         }
-    );
+        SDL_RenderClear(renderer);
+        SDL_RenderCopy(renderer, texture, nullptr, nullptr);
+        SDL_RenderPresent(renderer);
+    }
+
+    emulation.join();
 
-    if (audio_dev != 0) SDL_CloseAudioDevice(audio_dev);
+    fprintf(stderr, "Frames: %llu emulated, %llu dropped, %llu presented twice\n",
+            static_cast<unsigned long long>(frames.frames_published()),
+            static_cast<unsigned long long>(frames.frames_dropped()),
+            static_cast<unsigned long long>(frames.frames_duplicated()));
+
+    if (audio_dev != 0) {
+        SDL_CloseAudioDevice(audio_dev);
+        fprintf(stderr, "Audio: %llu frames dropped (ring full), %llu padded with silence\n",
+                static_cast<unsigned long long>(audio_ring.overrun_frames()),
+                static_cast<unsigned long long>(audio_ring.underrun_frames()));
+        fprintf(stderr, "Audio: ring %.0f%% full, rate x%.4f to x%.4f\n",
+                gameboy.get_audio_telemetry().fill_level * 100.0, rate_min, rate_max);
+    }
     SDL_DestroyTexture(texture);
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
@@ -0,0 +1,200 @@
+#include "checks.h"
+
+#include "../../src/apu/blip_buffer.h"
+#include "../../src/apu/channel_output.h"
+#include "../../src/apu/frequency_timer.h"
+#include "../../src/apu/noise_channel.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+/* A frequency timer run a cycle at a time. Like advance_timer, one that
+ * has already run out counts at once and reloads. */
+static auto step_timer(int& timer, u32 period, u32 elapsed) -> u32 {
+    u32 steps = 0;
+    if (timer <= 0) { timer = static_cast<int>(period); steps++; }
+
+    for (u32 n = 0; n < elapsed; n++) {
+        if (--timer == 0) { timer = static_cast<int>(period); steps++; }
+    }
+    return steps;
+}
+
+static auto check_advance_timer(uint seed) -> bool {
+    std::mt19937 rng(seed);
+
+    for (uint n = 0; n < 5000; n++) {
+        /* Periods of every channel, from the noise channel's shortest to the
+         * square channels' longest */
+        u32 period = rng() % 4 == 0 ? 1 + rng() % 8 : 1 + rng() % 8192;
+        int start = static_cast<int>(rng() % (period + 1));
+        u32 elapsed = rng() % 4 == 0 ? rng() % 16 : rng() % 10000;
+
+        int timer = start;
+        u32 steps = advance_timer(timer, period, elapsed);
+        int stepped_timer = start;
+        u32 stepped_steps = step_timer(stepped_timer, period, elapsed);
+
+        if (steps != stepped_steps || timer != stepped_timer) {
+            fprintf(stderr, "apu: advance_timer(%d, %u, %u) gave %u steps to %d, stepping gave %u to %d\n",
+                    start, period, elapsed, steps, timer, stepped_steps, stepped_timer);
+            return false;
+        }
+
+        /* cycles_to_step lands exactly on the step asked for */
+        u32 wanted = 1 + rng() % 16;
+        s64 until = cycles_to_step(start, period, wanted);
+        if (until < 0) { continue; }
+
+        timer = start;
+        u32 reached = advance_timer(timer, period, static_cast<u32>(until));
+        timer = start;
+        u32 short_of = until > 0 ? advance_timer(timer, period, static_cast<u32>(until - 1)) : 0;
+
+        if (reached != wanted || (until > 0 && short_of != wanted - 1)) {
+            fprintf(stderr, "apu: cycles_to_step(%d, %u, %u) = %lld reaches %u steps\n",
+                    start, period, wanted, static_cast<long long>(until), reached);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/* The noise channel as it used to run: the timer a cycle at a time and the
+ * LFSR a bit at a time, reporting the output every cycle. Only what the
+ * check writes is modelled: no length counter or envelope. */
+struct ReferenceNoise {
+    bool enabled = false;
+    u8 volume = 0;
+    u8 clock_shift = 0;
+    bool width_mode = false;
+    u8 divisor_code = 0;
+    int timer = 0;
+    u16 lfsr = 0x7FFF;
+
+    auto period() const -> int {
+        static const int divisors[8] = { 8, 16, 32, 48, 64, 80, 96, 112 };
+        return divisors[divisor_code] << clock_shift;
+    }
+
+    auto amplitude() const -> int { return enabled && (lfsr & 0x1) == 0 ? volume : 0; }
+
+    void write_nr43(u8 value) {
+        clock_shift = (value >> 4) & 0xF;
+        width_mode = (value & 0x8) != 0;
+        divisor_code = value & 0x7;
+    }
+
+    void trigger(u8 new_volume) {
+        enabled = true;
+        volume = new_volume;
+        timer = period();
+        lfsr = 0x7FFF;
+    }
+
+    void step_lfsr() {
+        u16 xor_bit = (lfsr ^ (lfsr >> 1)) & 0x1;
+        lfsr = static_cast<u16>((lfsr >> 1) | (xor_bit << 14));
+        if (width_mode) { lfsr = static_cast<u16>((lfsr & ~(1 << 6)) | (xor_bit << 6)); }
+    }
+
+    void run(u32 time, u32 end_time, ChannelOutput& out) {
+        out.update(time, amplitude());
+        if (!enabled) { return; }
+
+        for (; time < end_time; time++) {
+            if (--timer <= 0) {
+                timer = period();
+                step_lfsr();
+            }
+            out.update(time + 1, amplitude());
+        }
+    }
+};
+
+/* One side's worth of output, mixed into samples */
+struct SampleRecorder {
+    BlipBuffer left = BlipBuffer(1 << 16);
+    BlipBuffer right = BlipBuffer(1 << 16);
+    ChannelOutput output;
+    std::vector<s16> samples = std::vector<s16>(1 << 16);
+
+    SampleRecorder() {
+        left.set_rates(CLOCK_RATE, CLOCK_RATE / 4.0);
+        right.set_rates(CLOCK_RATE, CLOCK_RATE / 4.0);
+        output.set_buffers(&left, &right);
+        output.set_gains(0, 1, 0);
+    }
+
+    auto end_frame(u32 cycles) -> uint {
+        left.end_frame(cycles);
+        right.end_frame(cycles);
+        right.clear();
+        return left.read_samples(samples.data(), static_cast<uint>(samples.size()));
+    }
+};
+
+/* Random NR43 writes switch the LFSR width under it, which in 7-bit mode
+ * can leave the low bits, and then the whole register, all zeros */
+static auto check_noise_channel(uint seed) -> bool {
+    std::mt19937 rng(seed);
+
+    NoiseChannel channel;
+    ReferenceNoise reference;
+    SampleRecorder channel_out;
+    SampleRecorder reference_out;
+
+    /* A trigger with NR42 all zeros would leave the channel off */
+    u8 volume = 15;
+    channel.write_nr42(static_cast<u8>(volume << 4));
+
+    for (uint n = 0; n < 3000; n++) {
+        u32 cycles = rng() % 4 == 0 ? rng() % 64 : rng() % 4000;
+        channel.run(0, cycles, channel_out.output);
+        reference.run(0, cycles, reference_out.output);
+
+        uint count = channel_out.end_frame(cycles);
+        uint reference_count = reference_out.end_frame(cycles);
+        if (count != reference_count
+                || !std::equal(channel_out.samples.begin(), channel_out.samples.begin() + count,
+                               reference_out.samples.begin())) {
+            fprintf(stderr, "apu: noise channel output differs after %u writes (NR43 0x%02X, LFSR 0x%04X)\n",
+                    n, channel.read_nr43(), reference.lfsr);
+            return false;
+        }
+
+        u8 value = static_cast<u8>(rng());
+        switch (rng() % 4) {
+            case 0:
+                /* Volume only: the envelope stays still */
+                volume = static_cast<u8>(1 + value % 15);
+                channel.write_nr42(static_cast<u8>(volume << 4));
+                break;
+            case 1:
+            case 2:
+                /* Keep the period short enough to step within a frame */
+                value = static_cast<u8>(value & 0x7F);
+                channel.write_nr43(value);
+                reference.write_nr43(value);
+                break;
+            case 3:
+                channel.write_nr44(0x80);
+                reference.trigger(volume);
+                break;
+        }
+    }
+
+    return true;
+}
+
+auto check_apu() -> bool {
+    bool passed = true;
+    for (uint seed = 1; seed <= 4; seed++) {
+        passed &= check_advance_timer(seed);
+        passed &= check_noise_channel(seed);
+    }
+    return passed;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "../../src/definitions.h"
+
+#include <vector>
+
+/* Self-checks for the parts of the emulator worked out in closed form or
+ * driven by events, where a slip is easy to make and hard to see. Run with
+ * gbemu-test --check game.gb, or ctest. Each reports what went wrong on
+ * stderr and returns whether it passed. */
+
+/* Frame checks run the game given as well as ROMs of their own */
+auto check_frames(const std::vector<u8>& game) -> bool;
+auto check_timer() -> bool;
+auto check_apu() -> bool;
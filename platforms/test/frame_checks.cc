@@ -0,0 +1,249 @@
+#include "checks.h"
+
+#include "../../src/gameboy_prelude.h"
+#include "../../src/video/ppu_compat.h"
+
+#include <cstdio>
+#include <vector>
+
+static const uint GAME_FRAMES = 80;
+static const uint TIER_FRAMES = 600;
+static const uint SCENE_FRAMES = 300;
+
+/* The boot ROM won't hand over to a cartridge without these */
+static const u8 NINTENDO_LOGO[48] = {
+    0xCE, 0xED, 0x66, 0x66, 0xCC, 0x0D, 0x00, 0x0B, 0x03, 0x73, 0x00, 0x83, 0x00, 0x0C, 0x00, 0x0D,
+    0x00, 0x08, 0x11, 0x1F, 0x88, 0x89, 0x00, 0x0E, 0xDC, 0xCC, 0x6E, 0xE6, 0xDD, 0xDD, 0xD9, 0x99,
+    0xBB, 0xBB, 0x67, 0x63, 0x6E, 0x0E, 0xEC, 0xCC, 0xDD, 0xDC, 0x99, 0x9F, 0xBB, 0xB9, 0x33, 0x3E,
+};
+
+/* A 32KB cartridge with no MBC that jumps to program at 0x150 */
+static auto make_rom(const std::vector<u8>& program) -> std::vector<u8> {
+    std::vector<u8> rom(0x8000, 0);
+
+    const u8 entry[] = { 0x00, 0xC3, 0x50, 0x01 }; /* NOP; JP 0x0150 */
+    std::copy(std::begin(entry), std::end(entry), rom.begin() + 0x100);
+    std::copy(std::begin(NINTENDO_LOGO), std::end(NINTENDO_LOGO), rom.begin() + 0x104);
+
+    u8 checksum = 0;
+    for (uint n = 0x134; n <= 0x14C; n++) { checksum = static_cast<u8>(checksum - rom[n] - 1); }
+    rom[0x14D] = checksum;
+
+    std::copy(program.begin(), program.end(), rom.begin() + 0x150);
+    return rom;
+}
+
+static auto all_pixels(const FrameBuffer& frame, Color color) -> bool {
+    for (uint y = 0; y < GAMEBOY_HEIGHT; y++) {
+        for (uint x = 0; x < GAMEBOY_WIDTH; x++) {
+            if (frame.get_pixel(x, y) != color) { return false; }
+        }
+    }
+    return true;
+}
+
+/* Switching the LCD off in VBlank finishes the frame there and then, and
+ * run_frame() must return it rather than the blank one a frame later. The
+ * program draws one whole frame with BGP set to all black, then switches
+ * off in the VBlank after it. */
+static auto check_lcd_off_in_vblank() -> bool {
+    const std::vector<u8> program = {
+        0xF0, 0x44, 0xFE, 0x90, 0x20, 0xFA, /* wait for LY 144 */
+        0x3E, 0xFF, 0xE0, 0x47,             /* BGP = 0xFF */
+        0xF0, 0x44, 0xB7, 0x20, 0xFB,       /* wait for LY 0 */
+        0xF0, 0x44, 0xFE, 0x90, 0x20, 0xFA, /* wait for LY 144 */
+        0xAF, 0xE0, 0x40,                   /* LCDC = 0 */
+        0x18, 0xFE,                         /* loop */
+    };
+
+    Options options;
+    options.disable_logs = true;
+    Gameboy gameboy(make_rom(program), options);
+
+    for (uint n = 0; n < 1000; n++) {
+        if (all_pixels(gameboy.run_frame(), Color::Black)) { return true; }
+    }
+
+    fprintf(stderr, "frames: the frame finished by switching the LCD off was never returned\n");
+    return false;
+}
+
+/* Frame hashes from a headless run, with the frames to keep asked for the
+ * way gbemu-headless does for --capture-every: once the frame before has
+ * been handed over. Frames not kept are left out. */
+static auto kept_frame_hashes(const std::vector<u8>& game, PpuAccuracy accuracy, uint every) -> std::vector<u64> {
+    Options options;
+    options.disable_logs = true;
+    options.headless = true;
+    options.ppu_accuracy = accuracy;
+    Gameboy gameboy(game, options);
+    gameboy.request_frame();
+
+    std::vector<u64> hashes;
+    for (uint n = 0; n < GAME_FRAMES; n++) {
+        const FrameBuffer& frame = gameboy.run_frame();
+        if (n % every == 0) { hashes.push_back(frame.hash()); }
+        if ((n + 1) % every == 0) { gameboy.request_frame(); }
+    }
+    return hashes;
+}
+
+/* A frame asked for as soon as the one before is handed over must be the
+ * one rendered, so keeping every other frame gives every other frame of a
+ * run that keeps them all */
+static auto check_requested_frames(const std::vector<u8>& game) -> bool {
+    bool passed = true;
+
+    for (PpuAccuracy accuracy : { PpuAccuracy::Fast, PpuAccuracy::Accurate }) {
+        std::vector<u64> all = kept_frame_hashes(game, accuracy, 1);
+        std::vector<u64> halves = kept_frame_hashes(game, accuracy, 2);
+
+        for (uint n = 0; n < halves.size(); n++) {
+            if (halves[n] != all[n * 2]) {
+                fprintf(stderr, "frames: %s PPU rendered the wrong frame for request %u of every other frame\n",
+                        ppu_compat::accuracy_name(accuracy), n);
+                passed = false;
+                break;
+            }
+        }
+    }
+
+    return passed;
+}
+
+/* Hashes of the first frames of a run that renders every frame */
+static auto frame_hashes(const std::vector<u8>& game, Options options, uint frames) -> std::vector<u64> {
+    options.disable_logs = true;
+    Gameboy gameboy(game, options);
+
+    std::vector<u64> hashes;
+    for (uint n = 0; n < frames; n++) { hashes.push_back(gameboy.run_frame().hash()); }
+    return hashes;
+}
+
+static auto first_difference(const std::vector<u64>& a, const std::vector<u64>& b) -> uint {
+    uint n = 0;
+    while (n < a.size() && n < b.size() && a[n] == b[n]) { n++; }
+    return n;
+}
+
+/* The accurate PPU must draw a frame whose registers only change between
+ * frames just as the fast one does. The program scrolls the background and
+ * moves 40 sprites of the boot ROM's logo tiles, with every palette, flip
+ * and priority, over a window, all from VBlank. */
+static auto check_tiers_agree() -> bool {
+    const std::vector<u8> program = {
+        0xF0, 0x44, 0xFE, 0x90, 0x20, 0xFA, /* wait for LY 144 */
+        0x3E, 0xE4, 0xE0, 0x47,             /* BGP */
+        0x3E, 0xD2, 0xE0, 0x48,             /* OBP0 */
+        0x3E, 0x1B, 0xE0, 0x49,             /* OBP1 */
+        0x3E, 0x38, 0xE0, 0x4A,             /* WY */
+        0x3E, 0x3F, 0xE0, 0x4B,             /* WX */
+        0x3E, 0xB3, 0xE0, 0x40,             /* LCDC: window, sprites and background on */
+
+        0xF0, 0x44, 0xFE, 0x90, 0x20, 0xFA, /* each frame: wait for LY 144 */
+        0x1C,                               /* E counts frames */
+        0x7B, 0xE0, 0x43,                   /* SCX = E */
+        0x21, 0x00, 0xFE,                   /* HL = OAM */
+        0x06, 0x28,                         /* B = 40 sprites */
+        0x78, 0x87, 0x87, 0x83, 0xE6, 0x7F, 0x22, /* Y = (4B + E) & 0x7F */
+        0x78, 0x87, 0x87, 0x80, 0x93, 0x22,       /* X = 5B - E */
+        0x78, 0xE6, 0x1F, 0x22,                   /* tile = B & 0x1F */
+        0x78, 0x07, 0x07, 0x07, 0x07, 0xE6, 0xF0, 0x22, /* flags = B << 4 */
+        0x05, 0x20, 0xE4,                   /* next sprite */
+        0xF0, 0x44, 0xB7, 0x20, 0xFB,       /* wait for LY 0 */
+        0x18, 0xCE,                         /* next frame */
+    };
+
+    Options fast;
+    fast.ppu_accuracy = PpuAccuracy::Fast;
+    Options accurate;
+    accurate.ppu_accuracy = PpuAccuracy::Accurate;
+
+    std::vector<u64> fast_hashes = frame_hashes(make_rom(program), fast, SCENE_FRAMES);
+    std::vector<u64> accurate_hashes = frame_hashes(make_rom(program), accurate, SCENE_FRAMES);
+
+    uint differs_at = first_difference(fast_hashes, accurate_hashes);
+    if (differs_at == SCENE_FRAMES) { return true; }
+
+    fprintf(stderr, "frames: the PPU tiers differ at frame %u of a scene without mid-line writes\n", differs_at);
+    return false;
+}
+
+static auto deferred_lines_agree(const std::vector<u8>& rom, const char* what) -> bool {
+    Options deferred;
+    deferred.ppu_accuracy = PpuAccuracy::Fast;
+    Options at_once = deferred;
+    at_once.render_thread = true;
+
+    /* The render thread hands each frame over a frame late */
+    std::vector<u64> at_once_hashes = frame_hashes(rom, at_once, SCENE_FRAMES + 1);
+    at_once_hashes.erase(at_once_hashes.begin());
+
+    uint differs_at = first_difference(frame_hashes(rom, deferred, SCENE_FRAMES), at_once_hashes);
+    if (differs_at == SCENE_FRAMES) { return true; }
+
+    fprintf(stderr, "frames: deferred lines differ from lines drawn at once at frame %u of %s\n", differs_at, what);
+    return false;
+}
+
+/* Without a render thread, lines are drawn in batches, flushed early only
+ * by a write to something one of them reads, while the render thread draws
+ * each line as soon as it is finished. The two must agree on a game and on
+ * a program that, in every HBLANK, changes a byte at a pointer walking
+ * through all of VRAM and at one walking through the top of the background
+ * map, and moves a sprite along. */
+static auto check_deferred_lines(const std::vector<u8>& game) -> bool {
+    const std::vector<u8> program = {
+        0xF0, 0x44, 0xFE, 0x90, 0x20, 0xFA, /* wait for LY 144 */
+        0x3E, 0x50, 0xEA, 0x00, 0xFE,       /* sprite 0 Y */
+        0x3E, 0x01, 0xEA, 0x02, 0xFE,       /* sprite 0 tile */
+        0x3E, 0x93, 0xE0, 0x40,             /* LCDC: sprites and background on */
+        0x21, 0x00, 0x80,                   /* HL = VRAM */
+        0x11, 0x00, 0x98,                   /* DE = background map */
+
+        0xF0, 0x41, 0xE6, 0x03, 0x20, 0xFA, /* each line: wait for HBLANK */
+        0x34, 0x23,                         /* increment (HL++) */
+        0x7C, 0xFE, 0xA0, 0x20, 0x03,       /* past the end of VRAM? */
+        0x21, 0x00, 0x80,                   /*   HL = VRAM */
+        0x1A, 0x3D, 0x12, 0x1C,             /* decrement (DE), E++ */
+        0xFA, 0x01, 0xFE, 0x3C, 0xEA, 0x01, 0xFE, /* sprite 0 X++ */
+        0xF0, 0x41, 0xE6, 0x03, 0x28, 0xFA, /* wait for HBLANK to end */
+        0x18, 0xDD,                         /* next line */
+    };
+
+    bool passed = deferred_lines_agree(game, "the game");
+    passed &= deferred_lines_agree(make_rom(program), "the VRAM writing program");
+    return passed;
+}
+
+/* A game the compatibility list pins to the fast PPU must look the same on
+ * the accurate one */
+static auto check_listed_tier(const std::vector<u8>& game) -> bool {
+    std::string title = get_info(game)->title;
+    if (ppu_compat::listed_accuracy(title) != PpuAccuracy::Fast) { return true; }
+
+    Options fast;
+    fast.ppu_accuracy = PpuAccuracy::Fast;
+    Options accurate;
+    accurate.ppu_accuracy = PpuAccuracy::Accurate;
+
+    std::vector<u64> fast_hashes = frame_hashes(game, fast, TIER_FRAMES);
+    std::vector<u64> accurate_hashes = frame_hashes(game, accurate, TIER_FRAMES);
+
+    uint differs_at = first_difference(fast_hashes, accurate_hashes);
+    if (differs_at == TIER_FRAMES) { return true; }
+
+    fprintf(stderr, "frames: %s is listed for the fast PPU but frame %u differs on the accurate one\n",
+            title.c_str(), differs_at);
+    return false;
+}
+
+auto check_frames(const std::vector<u8>& game) -> bool {
+    bool passed = check_lcd_off_in_vblank();
+    passed &= check_requested_frames(game);
+    passed &= check_tiers_agree();
+    passed &= check_deferred_lines(game);
+    passed &= check_listed_tier(game);
+    return passed;
+}
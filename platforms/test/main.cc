@@ -1,11 +1,21 @@
 #include "../../src/gameboy_prelude.h"
 #include "../cli/cli.h"
+#include "checks.h"
+
+#include <cstring>
 
 static std::unique_ptr<CartridgeInfo> info;
 
 int main(int argc, char* argv[]) {
+    if (argc == 3 && strcmp(argv[1], "--check") == 0) {
+        bool passed = check_frames(read_bytes(argv[2]));
+        passed &= check_timer();
+        passed &= check_apu();
+        return passed ? 0 : 1;
+    }
+
     CliOptions cliOptions = get_cli_options(argc, argv);
     auto rom_data = read_bytes(cliOptions.filename);
     info = get_info(rom_data);
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,166 @@
+#include "checks.h"
+
+#include "../../src/timer.h"
+
+#include <cstdio>
+#include <random>
+
+/* The timer as the hardware builds it: a 16-bit counter stepped every
+ * T-cycle, and TIMA incremented on each falling edge of the counter bit TAC
+ * selects ANDed with the enable bit. Writes to DIV and TAC can make an edge
+ * of their own. */
+struct ReferenceTimer {
+    u16 counter = 0;
+    u8 tima = 0;
+    u8 tma = 0;
+    u8 tac = 0;
+    uint interrupts = 0;
+
+    auto signal() const -> bool {
+        static const uint bits[4] = { 9, 3, 5, 7 };
+        return (tac & 0x4) != 0 && ((counter >> bits[tac & 0x3]) & 1) != 0;
+    }
+
+    void increment() {
+        if (tima == 0xFF) {
+            tima = tma;
+            interrupts++;
+        } else {
+            tima++;
+        }
+    }
+
+    /* Runs fn, then increments TIMA if it made a falling edge */
+    template <typename Fn>
+    void edge_around(Fn&& fn) {
+        bool was_high = signal();
+        fn();
+        if (was_high && !signal()) { increment(); }
+    }
+
+    /* One cycle of the master clock is four T-cycles */
+    void step() {
+        for (uint n = 0; n < 4; n++) { edge_around([&] { counter++; }); }
+    }
+
+    void reset_divider() { edge_around([&] { counter = 0; }); }
+    void set_timer_control(u8 value) { edge_around([&] { tac = value & 0x7; }); }
+};
+
+/* Timer driven the way Gameboy drives it, next to the reference */
+struct TimerPair {
+    u64 clock = 0;
+    ByteRegister interrupt_flag;
+    Timer timer = Timer(clock, interrupt_flag);
+    uint interrupts = 0;
+
+    ReferenceTimer reference;
+
+    void collect_interrupt() {
+        if (!interrupt_flag.check_bit(2)) { return; }
+        interrupts++;
+        interrupt_flag.set_bit_to(2, false);
+    }
+
+    /* Stops at the first cycle the two disagree on */
+    auto run(u64 cycles, const char* what) -> bool {
+        for (u64 n = 0; n < cycles; n++) {
+            reference.step();
+            clock++;
+            if (clock >= timer.next_event_cycle()) { timer.catch_up(clock); }
+            collect_interrupt();
+            if (!matches(what)) { return false; }
+        }
+        return true;
+    }
+
+    void reset_divider() { reference.reset_divider(); timer.reset_divider(); collect_interrupt(); }
+    void set_timer(u8 value) { reference.tima = value; timer.set_timer(value); collect_interrupt(); }
+    void set_timer_modulo(u8 value) { reference.tma = value; timer.set_timer_modulo(value); collect_interrupt(); }
+    void set_timer_control(u8 value) { reference.set_timer_control(value); timer.set_timer_control(value); collect_interrupt(); }
+
+    auto matches(const char* what) const -> bool {
+        bool same = timer.get_divider() == (reference.counter >> 8)
+            && timer.get_timer() == reference.tima
+            && timer.get_timer_control() == (0xF8 | reference.tac)
+            && interrupts == reference.interrupts;
+
+        if (!same) {
+            fprintf(stderr, "timer: %s at cycle %llu: DIV %u/%u, TIMA %u/%u, TAC 0x%02X/0x%02X, interrupts %u/%u\n",
+                    what, static_cast<unsigned long long>(clock),
+                    timer.get_divider(), reference.counter >> 8,
+                    timer.get_timer(), reference.tima,
+                    timer.get_timer_control(), 0xF8 | reference.tac,
+                    interrupts, reference.interrupts);
+        }
+        return same;
+    }
+};
+
+/* The writes that make an edge of their own, each landing with the
+ * selected bit high and low */
+static auto check_timer_edges() -> bool {
+    bool passed = true;
+
+    for (u8 tac = 0x4; tac <= 0x7; tac++) {
+        for (u64 offset = 0; offset < 160; offset++) {
+            TimerPair div_reset;
+            div_reset.set_timer_control(tac);
+            passed &= div_reset.run(offset, "before DIV reset");
+            div_reset.reset_divider();
+            passed &= div_reset.run(300, "DIV reset");
+
+            TimerPair timer_off;
+            timer_off.set_timer_control(tac);
+            passed &= timer_off.run(offset, "before TAC disable");
+            timer_off.set_timer_control(tac & 0x3);
+            passed &= timer_off.run(300, "TAC disable");
+
+            TimerPair reselect;
+            reselect.set_timer_control(tac);
+            passed &= reselect.run(offset, "before TAC reselect");
+            reselect.set_timer_control(0x4 | ((tac + 1) & 0x3));
+            passed &= reselect.run(300, "TAC reselect");
+
+            /* Overflowing from an edge made by a write reloads from TMA */
+            TimerPair overflow;
+            overflow.set_timer_modulo(0xF0);
+            overflow.set_timer_control(tac);
+            passed &= overflow.run(offset, "before DIV reset overflow");
+            overflow.set_timer(0xFF);
+            overflow.reset_divider();
+            passed &= overflow.run(300, "DIV reset overflow");
+        }
+    }
+
+    return passed;
+}
+
+/* Random writes between runs of random length */
+static auto check_timer_random(uint seed) -> bool {
+    std::mt19937 rng(seed);
+    TimerPair pair;
+
+    for (uint n = 0; n < 50000; n++) {
+        if (!pair.run(rng() % 8 == 0 ? rng() % 3000 : rng() % 6, "random run")) { return false; }
+
+        u8 value = static_cast<u8>(rng());
+        switch (rng() % 10) {
+            case 0: pair.reset_divider(); break;
+            case 1: pair.set_timer(value); break;
+            case 2: pair.set_timer_modulo(value); break;
+            case 3: pair.set_timer_control(value); break;
+            default: break;
+        }
+
+        if (!pair.matches("random writes")) { return false; }
+    }
+
+    return true;
+}
+
+auto check_timer() -> bool {
+    bool passed = check_timer_edges();
+    for (uint seed = 1; seed <= 4; seed++) { passed &= check_timer_random(seed); }
+    return passed;
+}
@@ -1,28 +1,87 @@
 #include "apu.h"
 
-APU::APU() : ch1_(true), ch2_(false) {}
+#include <algorithm>
 
-void APU::tick(int cycles) {
-    if (!apu_enabled_) return;
+static const u32    FRAME_SEQ_CYCLES = 8192;   // 512 Hz
+static const u32    AUDIO_FRAME_CYCLES = 65536;  // ~15.6 ms, ~690 samples
+static const double SAMPLE_RATE = 44100.0;
+
+// Rate control: the furthest the output rate is moved from SAMPLE_RATE, and
+// how much of each new fill reading goes into the smoothed level (the audio
+// thread pops in blocks, so single readings jump about). The integral term
+// takes out the steady offset a proportional term alone would leave when
+// the two clocks differ, so the ring settles at half full.
+static const double MAX_RATE_ADJUST = 0.005;
+static const double FILL_SMOOTHING  = 1.0 / 16;
+static const double INTEGRAL_GAIN   = 0.0002;
+
+// Fastest fast-forward that still has sound.
+static const uint MAX_STRETCH_SPEED = 4;
+
+// Each channel's amplitude (0–15) times its master volume (1–8) times this
+// gives its contribution to an output sample, so all four channels at full
+// volume come to 30720, just inside 16 bits.
+static const int GAIN_SCALE = 64;
+
+APU::APU(AudioSink* sink)
+    : ch1_(true), ch2_(false),
+      left_(4096), right_(4096),
+      samples_(4096 * 2),
+      sink_(sink ? sink : &null_sink_),
+      synthesise_(sink_->wants_samples()),
+      stretched_((4096 + TimeStretch::MAX_HELD) * 2) {
+    left_.set_rates(CLOCK_RATE, SAMPLE_RATE);
+    right_.set_rates(CLOCK_RATE, SAMPLE_RATE);
+    for (auto& out : outputs_) out.set_buffers(&left_, &right_);
+    update_gains();
+}
 
-    // Frame sequencer: fires at 512 Hz (every 8192 T-cycles).
-    frame_seq_counter_ += static_cast<uint>(cycles);
-    while (frame_seq_counter_ >= 8192) {
-        frame_seq_counter_ -= 8192;
-        clock_frame_sequencer();
+void APU::catch_up(u64 cycle) {
+    // In pieces no longer than what is left of the audio frame
+    while (synced_cycle_ < cycle) {
+        u32 cycles = static_cast<u32>(std::min<u64>(cycle - synced_cycle_, AUDIO_FRAME_CYCLES - time_));
+        run(cycles);
+        synced_cycle_ += cycles;
     }
+}
 
-    ch1_.tick(cycles);
-    ch2_.tick(cycles);
-    ch3_.tick(cycles);
-    ch4_.tick(cycles);
+void APU::run(u32 cycles) {
+    u32 end_time = time_ + cycles;
 
-    // Down-sample to 44100 Hz.
-    sample_timer_ += cycles;
-    while (sample_timer_ >= CYCLES_PER_SAMPLE) {
-        sample_timer_ -= CYCLES_PER_SAMPLE;
-        push_sample();
+    if (apu_enabled_) {
+        // Frame sequencer: fires at 512 Hz. Channels are run up to each step
+        // first, since it can change their levels.
+        while (frame_seq_counter_ + (end_time - time_) >= FRAME_SEQ_CYCLES) {
+            run_channels(time_ + (FRAME_SEQ_CYCLES - frame_seq_counter_));
+            frame_seq_counter_ = 0;
+            clock_frame_sequencer();
+        }
+        frame_seq_counter_ += end_time - time_;
+        run_channels(end_time);
+    } else {
+        // Powered off: silence, but still silence in time.
+        if (making_sound()) {
+            for (auto& out : outputs_) out.update(time_, 0);
+        }
+        time_ = end_time;
     }
+
+    if (time_ >= AUDIO_FRAME_CYCLES) end_frame();
+}
+
+void APU::run_channels(u32 end_time) {
+    // With nothing listening only the frame sequencer needs to run: it alone
+    // changes what the registers show.
+    if (!making_sound()) {
+        time_ = end_time;
+        return;
+    }
+
+    ch1_.run(time_, end_time, outputs_[0]);
+    ch2_.run(time_, end_time, outputs_[1]);
+    ch3_.run(time_, end_time, outputs_[2]);
+    ch4_.run(time_, end_time, outputs_[3]);
+    time_ = end_time;
 }
 
 void APU::clock_frame_sequencer() {
@@ -46,34 +105,95 @@ void APU::clock_frame_sequencer() {
     frame_seq_step_ = (frame_seq_step_ + 1) & 7;
 }
 
-void APU::push_sample() {
-    float s1 = ch1_.output();
-    float s2 = ch2_.output();
-    float s3 = ch3_.output();
-    float s4 = ch4_.output();
-
+void APU::update_gains() {
     // NR51 panning: bit4=CH1L, bit5=CH2L, bit6=CH3L, bit7=CH4L
     //               bit0=CH1R, bit1=CH2R, bit2=CH3R, bit3=CH4R
-    float left  = 0.0f;
-    float right = 0.0f;
-    if (nr51_ & 0x10) left  += s1;
-    if (nr51_ & 0x20) left  += s2;
-    if (nr51_ & 0x40) left  += s3;
-    if (nr51_ & 0x80) left  += s4;
-    if (nr51_ & 0x01) right += s1;
-    if (nr51_ & 0x02) right += s2;
-    if (nr51_ & 0x04) right += s3;
-    if (nr51_ & 0x08) right += s4;
-
-    // Normalise to 4 channels then apply NR50 master volume (1–8).
-    left  /= 4.0f;
-    right /= 4.0f;
-    float left_vol  = static_cast<float>(((nr50_ >> 4) & 0x7) + 1) / 8.0f;
-    float right_vol = static_cast<float>((nr50_ & 0x7) + 1) / 8.0f;
-
-    buffer_.push(left * left_vol, right * right_vol);
+    // NR50 master volume (1–8) applies to everything on that side.
+    int left_vol  = (((nr50_ >> 4) & 0x7) + 1) * GAIN_SCALE;
+    int right_vol = ((nr50_ & 0x7) + 1) * GAIN_SCALE;
+
+    for (uint n = 0; n < 4; n++) {
+        outputs_[n].set_gains(time_,
+                              (nr51_ & (0x10 << n)) ? left_vol : 0,
+                              (nr51_ & (0x01 << n)) ? right_vol : 0);
+    }
 }
 
+void APU::end_frame() {
+    u32 cycles = time_;
+    time_ = 0;
+    if (!synthesise_) return;
+
+    if (frame_audible_) {
+        left_.end_frame(cycles);
+        right_.end_frame(cycles);
+
+        uint count = left_.samples_avail();
+        left_.read_samples(samples_.data(), count, 2);
+        right_.read_samples(samples_.data() + 1, count, 2);
+
+        if (speed_ == 1) {
+            sink_->write(samples_.data(), count);
+        } else {
+            count = stretch_.process(samples_.data(), count, stretched_.data());
+            sink_->write(stretched_.data(), count);
+            samples_owed_ -= count;
+        }
+
+        if (rate_control_) adjust_rate();
+    }
+
+    if (speed_ == 1) return;
+
+    // Fast-forwarding: real time passes only 1/speed as fast as emulated
+    // time, so only that much sound is made. Whether the next frame is
+    // heard depends on whether what has been made so far has kept up.
+    bool was_audible = frame_audible_;
+    if (speed_ == 0 || speed_ > MAX_STRETCH_SPEED) {
+        frame_audible_ = false;
+    } else {
+        samples_owed_ += cycles * SAMPLE_RATE / CLOCK_RATE / speed_;
+        frame_audible_ = samples_owed_ > 0;
+    }
+    if (frame_audible_ && !was_audible) stretch_.begin_stretch();
+}
+
+void APU::set_speed(uint speed) {
+    if (speed == speed_) return;
+
+    // What was held back for the next seam is dropped: a few ms at most.
+    speed_         = speed;
+    samples_owed_  = 0.0;
+    frame_audible_ = speed != 0 && speed <= MAX_STRETCH_SPEED;
+    stretch_.reset();
+}
+
+void APU::adjust_rate() {
+    // Emptying ring: make up to 0.5% more samples per cycle; filling: fewer.
+    fill_level_ += (sink_->fill_level() - fill_level_) * FILL_SMOOTHING;
+
+    double error = 0.5 - fill_level_;
+    rate_integral_ = std::max(-MAX_RATE_ADJUST, std::min(MAX_RATE_ADJUST,
+                                                         rate_integral_ + error * INTEGRAL_GAIN));
+    double adjust = 2.0 * MAX_RATE_ADJUST * error + rate_integral_;
+    rate_ratio_ = 1.0 + std::max(-MAX_RATE_ADJUST, std::min(MAX_RATE_ADJUST, adjust));
+
+    left_.set_rates(CLOCK_RATE, SAMPLE_RATE * rate_ratio_);
+    right_.set_rates(CLOCK_RATE, SAMPLE_RATE * rate_ratio_);
+}
+
+void APU::set_rate_control(bool enabled) {
+    rate_control_ = enabled;
+    if (!enabled) {
+        rate_ratio_    = 1.0;
+        rate_integral_ = 0.0;
+        left_.set_rates(CLOCK_RATE, SAMPLE_RATE);
+        right_.set_rates(CLOCK_RATE, SAMPLE_RATE);
+    }
+}
+
+AudioTelemetry APU::telemetry() const { return {fill_level_, rate_ratio_}; }
+
 u8 APU::read(const Address& addr) const {
     u16 a = addr.value();
 
@@ -134,6 +254,7 @@ void APU::write(const Address& addr, u8 byte) {
             // Power-off: reset all sound registers.
             nr50_ = 0;
             nr51_ = 0;
+            update_gains();
             ch1_.write_nr0(0); ch1_.write_nr1(0); ch1_.write_nr2(0);
             ch1_.write_nr3(0); ch1_.write_nr4(0);
             ch2_.write_nr1(0); ch2_.write_nr2(0);
@@ -179,11 +300,10 @@ void APU::write(const Address& addr, u8 byte) {
         case 0xFF22: ch4_.write_nr43(byte); break;
         case 0xFF23: ch4_.write_nr44(byte); break;
 
-        case 0xFF24: nr50_ = byte; break;
-        case 0xFF25: nr51_ = byte; break;
+        case 0xFF24: nr50_ = byte; update_gains(); break;
+        case 0xFF25: nr51_ = byte; update_gains(); break;
 
         default: break;
     }
 }
 
-AudioBuffer& APU::get_buffer() { return buffer_; }
@@ -3,37 +3,97 @@
 #include "square_channel.h"
 #include "wave_channel.h"
 #include "noise_channel.h"
-#include "audio_buffer.h"
+#include "audio_sink.h"
+#include "blip_buffer.h"
+#include "channel_output.h"
+#include "time_stretch.h"
 #include "../definitions.h"
 #include "../address.h"
 
+#include <array>
+#include <vector>
+
+// Dynamic rate control as of the last audio frame.
+struct AudioTelemetry {
+    double fill_level;  // sink queue fill, 0–1, smoothed
+    double rate_ratio;  // output sample rate relative to 44.1 kHz
+};
+
 // Top-level Audio Processing Unit.
-// Mirrors the Video class pattern: owned by Gameboy, ticked each CPU step,
-// registers routed through MMU read_io/write_io.
+// Owned by Gameboy, registers routed through MMU read_io/write_io. It is
+// not ticked: nothing outside the APU can see its state between register
+// accesses, so it only runs when one happens or audio is drained, catching
+// up over all the cycles since it last ran in one go.
 class APU {
 public:
-    APU();
+    // Samples go to sink, which must outlive the APU. With none, or one
+    // that wants no samples, no sound is synthesised at all.
+    explicit APU(AudioSink* sink);
 
-    // Called after each CPU step with the number of T-cycles elapsed.
-    void tick(int cycles);
+    // Runs up to the given cycle of the master clock.
+    void catch_up(u64 cycle);
 
     // Register access for the MMU (0xFF10–0xFF3F).
     u8   read(const Address& addr) const;
     void write(const Address& addr, u8 byte);
 
-    // Platform layer drains samples from here each frame.
-    AudioBuffer& get_buffer();
+    // Ends the current audio frame, passing the samples made so far to the
+    // sink. Happens by itself every ~15 ms of emulated time while the APU
+    // runs.
+    void end_frame();
+
+    // With rate control on, the output sample rate is nudged by up to ±0.5%
+    // at each audio frame to keep the sink's queue half full. That soaks up
+    // the difference between the audio device's clock and the host's frame
+    // pacing, which would otherwise drift into underruns or dropped samples.
+    // Off by default: only useful with something draining the sink in real
+    // time.
+    void set_rate_control(bool enabled);
+    AudioTelemetry telemetry() const;
+
+    // How many times faster than real time emulation is running. Up to 4x,
+    // sound is made for only as many audio frames as real time calls for,
+    // with the rest skipped and the seams joined without changing pitch;
+    // beyond that, or with 0 for uncapped, fast-forward is silent.
+    void set_speed(uint speed);
 
 private:
+    void run(u32 cycles);
+    void run_channels(u32 end_time);
     void clock_frame_sequencer();
-    void push_sample();
+    void update_gains();
+    void adjust_rate();
+    bool making_sound() const { return synthesise_ && frame_audible_; }
 
     SquareChannel ch1_;  // CH1: square + sweep
     SquareChannel ch2_;  // CH2: square
     WaveChannel   ch3_;  // CH3: programmable wave
     NoiseChannel  ch4_;  // CH4: noise
 
-    AudioBuffer buffer_;
+    // Channels write level changes into the blip buffers as they happen;
+    // samples are only made from them when an audio frame ends.
+    BlipBuffer left_;
+    BlipBuffer right_;
+    std::array<ChannelOutput, 4> outputs_;
+    u32 time_ = 0;  // T-cycles into the current audio frame
+
+    u64 synced_cycle_ = 0;  // master clock cycle the APU has run up to
+
+    std::vector<s16> samples_;  // interleaved, read out of the blip buffers
+    NullAudioSink null_sink_;
+    AudioSink*    sink_;
+    bool          synthesise_;
+
+    bool   rate_control_ = false;
+    double fill_level_   = 0.5;
+    double rate_ratio_   = 1.0;
+    double rate_integral_ = 0.0;
+
+    uint   speed_         = 1;
+    bool   frame_audible_ = true;   // false for frames skipped in fast-forward
+    double samples_owed_  = 0.0;    // real time's worth not yet made
+    TimeStretch      stretch_;
+    std::vector<s16> stretched_;
 
     u8   nr50_        = 0;      // master volume
     u8   nr51_        = 0;      // left/right panning per channel
@@ -42,8 +102,4 @@ private:
     // 512 Hz frame sequencer (one step every 8192 T-cycles).
     uint frame_seq_counter_ = 0;
     uint frame_seq_step_    = 0;
-
-    // Down-sampler: accumulate T-cycles and emit one stereo pair at ~44100 Hz.
-    double sample_timer_              = 0.0;
-    static constexpr double CYCLES_PER_SAMPLE = 4194304.0 / 44100.0;
 };
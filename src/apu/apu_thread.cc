@@ -0,0 +1,82 @@
+#include "apu_thread.h"
+
+#include <algorithm>
+
+ApuThread::ApuThread(AudioSink* sink)
+    : apu_(sink),
+      thread_(&ApuThread::run, this) {}
+
+ApuThread::~ApuThread() {
+    push({0, ApuEventType::Stop, 0, 0});
+    thread_.join();
+}
+
+void ApuThread::write(u64 cycle, const Address& addr, u8 byte) {
+    push({cycle, ApuEventType::Write, byte, addr.value()});
+}
+
+void ApuThread::flush(u64 cycle) {
+    push({cycle, ApuEventType::Flush, 0, 0});
+}
+
+void ApuThread::set_rate_control(bool enabled) {
+    push({0, ApuEventType::RateControl, enabled, 0});
+}
+
+void ApuThread::set_speed(uint speed) {
+    push({0, ApuEventType::Speed, static_cast<u8>(std::min(speed, 255u)), 0});
+}
+
+AudioTelemetry ApuThread::telemetry() const {
+    return {fill_level_.load(std::memory_order_relaxed), rate_ratio_.load(std::memory_order_relaxed)};
+}
+
+void ApuThread::wait() {
+    played_ready_.wait_until([&] { return played_.load(std::memory_order_acquire) == logged_; });
+}
+
+void ApuThread::push(const ApuEvent& event) {
+    // A full queue means the APU thread is behind: wait for it rather than
+    // drop anything.
+    space_ready_.wait_until([&] { return events_.try_push(event); });
+    events_ready_.notify();
+    logged_++;
+}
+
+void ApuThread::run() {
+    ApuEvent event;
+
+    while (true) {
+        if (!events_.try_pop(event)) {
+            events_ready_.wait_until([&] { return events_.try_pop(event); });
+        }
+        space_ready_.notify();
+
+        switch (event.type) {
+            case ApuEventType::Write:
+                apu_.catch_up(event.cycle);
+                apu_.write(event.address, event.value);
+                break;
+            case ApuEventType::Flush: {
+                apu_.catch_up(event.cycle);
+                apu_.end_frame();
+
+                AudioTelemetry telemetry = apu_.telemetry();
+                fill_level_.store(telemetry.fill_level, std::memory_order_relaxed);
+                rate_ratio_.store(telemetry.rate_ratio, std::memory_order_relaxed);
+                break;
+            }
+            case ApuEventType::RateControl:
+                apu_.set_rate_control(event.value != 0);
+                break;
+            case ApuEventType::Speed:
+                apu_.set_speed(event.value);
+                break;
+            case ApuEventType::Stop:
+                return;
+        }
+
+        played_.fetch_add(1, std::memory_order_release);
+        played_ready_.notify();
+    }
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "apu.h"
+#include "../definitions.h"
+#include "../util/spsc_queue.h"
+#include "../util/wake_signal.h"
+
+#include <atomic>
+#include <thread>
+
+enum class ApuEventType : u8 {
+    Write,        // register write
+    Flush,        // end the audio frame
+    RateControl,  // value is whether it's on
+    Speed,        // value is the speed
+    Stop,
+};
+
+// One entry in the stream of what the APU thread must replay, stamped with
+// the master clock cycle it happened at.
+struct ApuEvent {
+    u64          cycle;
+    ApuEventType type;
+    u8           value;
+    u16          address;
+};
+
+// Runs an APU synthesising sound on a thread of its own. The emulation
+// thread logs register writes with the cycle each happened at into a
+// lock-free queue, and the APU thread catches up to each one and applies
+// it in turn, so the sound matches running the APU inline. The emulation
+// thread still answers register reads itself, from an APU with no sink:
+// that keeps only the state the registers show, such as which channels
+// NR52 reports as on, and costs next to nothing.
+class ApuThread {
+public:
+    // sink is only ever written to from the APU thread.
+    explicit ApuThread(AudioSink* sink);
+    ~ApuThread();
+
+    void write(u64 cycle, const Address& addr, u8 byte);
+
+    // Ends the audio frame at cycle, passing its samples to the sink.
+    void flush(u64 cycle);
+
+    void set_rate_control(bool enabled);
+    void set_speed(uint speed);
+
+    // As of the last audio frame the APU thread finished.
+    AudioTelemetry telemetry() const;
+
+    // Blocks until everything logged so far has been played out, e.g. before
+    // closing a file sink.
+    void wait();
+
+private:
+    void push(const ApuEvent& event);
+    void run();
+
+    APU apu_;
+
+    SpscQueue<ApuEvent, 1 << 14> events_;
+
+    // Each side sleeps on one of these when it has to wait for the other:
+    // the APU thread for events, the emulation thread for room in the queue
+    // or for everything to be played out.
+    WakeSignal events_ready_;
+    WakeSignal space_ready_;
+    WakeSignal played_ready_;
+
+    // Events logged by the emulation thread, and played out by the APU
+    // thread.
+    u64 logged_ = 0;
+    std::atomic<u64> played_ = {0};
+
+    std::atomic<double> fill_level_ = {0.5};
+    std::atomic<double> rate_ratio_ = {1.0};
+
+    std::thread thread_;
+};
@@ -1,12 +1,95 @@
 #include "audio_buffer.h"
 
-void AudioBuffer::push(float left, float right) {
-    samples_.push_back(left);
-    samples_.push_back(right);
+#include "../util/log.h"
+
+#include <algorithm>
+#include <cstring>
+
+// Copies count frames between a ring of the given capacity, starting at
+// frame index, and flat memory, in up to two pieces where it wraps.
+template <typename Copy>
+static void for_each_span(size_t capacity, size_t index, size_t count, Copy copy) {
+    size_t start = index & (capacity - 1);
+    size_t first = std::min(count, capacity - start);
+    copy(start, 0, first);
+    if (first < count) copy(0, first, count - first);
+}
+
+AudioBuffer::AudioBuffer(size_t capacity)
+    : samples_(capacity * 2), capacity_(capacity) {
+    if ((capacity & (capacity - 1)) != 0) {
+        fatal_error("Audio buffer capacity must be a power of two: %zu", capacity);
+    }
+}
+
+size_t AudioBuffer::push(const s16* samples, size_t count) {
+    size_t tail = write_index_.load(std::memory_order_relaxed);
+
+    if (capacity_ - (tail - cached_read_index_) < count) {
+        cached_read_index_ = read_index_.load(std::memory_order_acquire);
+    }
+    size_t fits = std::min(count, capacity_ - (tail - cached_read_index_));
+
+    for_each_span(capacity_, tail, fits, [&](size_t ring, size_t flat, size_t n) {
+        std::memcpy(&samples_[ring * 2], samples + flat * 2, n * 2 * sizeof(s16));
+    });
+    write_index_.store(tail + fits, std::memory_order_release);
+
+    if (fits < count) {
+        overruns_.fetch_add(count - fits, std::memory_order_relaxed);
+    }
+    return fits;
 }
 
-void AudioBuffer::clear() { samples_.clear(); }
+size_t AudioBuffer::pop(s16* out, size_t count) {
+    return pop(out, count, [](s16* to, const s16* from, size_t n) {
+        std::memcpy(to, from, n * sizeof(s16));
+    });
+}
+
+size_t AudioBuffer::pop(float* out, size_t count) {
+    return pop(out, count, [](float* to, const s16* from, size_t n) {
+        for (size_t i = 0; i < n; i++) to[i] = from[i] * (1.0f / 32768.0f);
+    });
+}
 
-size_t AudioBuffer::size() const { return samples_.size() / 2; }
+template <typename Sample, typename Convert>
+size_t AudioBuffer::pop(Sample* out, size_t count, Convert convert) {
+    size_t head = read_index_.load(std::memory_order_relaxed);
+
+    if (cached_write_index_ - head < count) {
+        cached_write_index_ = write_index_.load(std::memory_order_acquire);
+    }
+    size_t got = std::min(count, cached_write_index_ - head);
+
+    for_each_span(capacity_, head, got, [&](size_t ring, size_t flat, size_t n) {
+        convert(out + flat * 2, &samples_[ring * 2], n * 2);
+    });
+    read_index_.store(head + got, std::memory_order_release);
+
+    if (got < count) {
+        std::fill(out + got * 2, out + count * 2, Sample(0));
+        underruns_.fetch_add(count - got, std::memory_order_relaxed);
+    }
+    return got;
+}
+
+void AudioBuffer::clear() {
+    cached_write_index_ = write_index_.load(std::memory_order_acquire);
+    read_index_.store(cached_write_index_, std::memory_order_release);
+}
+
+size_t AudioBuffer::size() const {
+    size_t head = read_index_.load(std::memory_order_acquire);
+    size_t tail = write_index_.load(std::memory_order_acquire);
+    return tail - head;
+}
+
+size_t AudioBuffer::capacity() const { return capacity_; }
+
+double AudioBuffer::fill_level() const {
+    return static_cast<double>(size()) / static_cast<double>(capacity_);
+}
 
-const float* AudioBuffer::data() const { return samples_.data(); }
+u64 AudioBuffer::overrun_frames() const { return overruns_.load(std::memory_order_relaxed); }
+u64 AudioBuffer::underrun_frames() const { return underruns_.load(std::memory_order_relaxed); }
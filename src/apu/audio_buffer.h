@@ -1,17 +1,66 @@
 #pragma once
 
+#include "audio_sink.h"
+#include "../definitions.h"
+#include "../util/spsc_queue.h"
+
 #include <vector>
+#include <atomic>
 #include <cstddef>
 
-// Interleaved stereo float sample buffer (L, R, L, R, ...) fed to the audio backend.
-class AudioBuffer {
+// Fixed-capacity ring of interleaved stereo 16-bit samples (L, R, L, R, ...)
+// between the emulation thread, which pushes, and the audio backend, which
+// pops. Lock-free for exactly one producer and one consumer, and never
+// allocates. Samples that don't fit are dropped and reads that come up
+// short are padded with silence; both are counted.
+//
+// Samples are kept as the APU makes them; a backend that wants float pops
+// through the converting overload instead. As a sink, this is the one for
+// playing audio in real time.
+class AudioBuffer : public AudioSink {
 public:
-    void push(float left, float right);
+    static const size_t DEFAULT_CAPACITY = 4096;  // stereo frames, ~93 ms at 44.1 kHz
+
+    // Capacity is in stereo frames and must be a power of two. Storage is
+    // allocated here, once.
+    explicit AudioBuffer(size_t capacity = DEFAULT_CAPACITY);
+
+    // Producer: appends up to count frames, returning how many fit.
+    size_t push(const s16* samples, size_t count);
+
+    void write(const s16* samples, size_t count) override { push(samples, count); }
+    double fill_level() const override;
+
+    // Consumer: fills out with count frames, returning how many were real
+    // samples rather than padding. Float output is scaled to ±1.
+    size_t pop(s16* out, size_t count);
+    size_t pop(float* out, size_t count);
+
+    // Consumer: drops everything waiting.
     void clear();
 
-    size_t size() const;         // number of stereo pairs
-    const float* data() const;  // interleaved L/R
+    size_t size() const;  // frames waiting; approximate while the other side is active
+    size_t capacity() const;
+
+    u64 overrun_frames() const;   // frames dropped because the ring was full
+    u64 underrun_frames() const;  // frames of silence padded on empty reads
 
 private:
-    std::vector<float> samples_;
+    // Indices count frames and only ever grow; each side has its own cache
+    // line, with its last sight of the other side's index.
+    alignas(CACHE_LINE_BYTES) std::atomic<size_t> write_index_ = {0};
+    size_t cached_read_index_ = 0;
+    std::atomic<u64> overruns_ = {0};
+
+    alignas(CACHE_LINE_BYTES) std::atomic<size_t> read_index_ = {0};
+    size_t cached_write_index_ = 0;
+    std::atomic<u64> underruns_ = {0};
+
+    template <typename Sample, typename Convert>
+    size_t pop(Sample* out, size_t count, Convert convert);
+
+    // Written by the producer, read by the consumer; only the pointer and
+    // size are shared, and never change.
+    alignas(CACHE_LINE_BYTES) std::vector<s16> samples_;
+    size_t capacity_;
 };
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "../definitions.h"
+
+#include <cstddef>
+
+// Where the APU's samples go, chosen when the Gameboy is constructed.
+// Samples arrive as interleaved stereo 16-bit frames at the end of each
+// audio frame, always from the same thread: the emulation thread, or the
+// audio thread if there is one. A sink must never block there.
+class AudioSink {
+public:
+    virtual ~AudioSink() = default;
+
+    virtual void write(const s16* samples, size_t count) = 0;
+
+    // A sink that wants nothing lets the APU skip synthesis altogether.
+    virtual bool wants_samples() const { return true; }
+
+    // How full the sink's queue is, 0–1, for rate control. Sinks that
+    // aren't drained in real time have no say and sit at half full.
+    virtual double fill_level() const { return 0.5; }
+};
+
+// For runs nobody listens to: the APU keeps only the state the CPU can
+// see through the registers.
+class NullAudioSink : public AudioSink {
+public:
+    void write(const s16*, size_t) override {}
+    bool wants_samples() const override { return false; }
+};
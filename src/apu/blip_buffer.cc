@@ -0,0 +1,124 @@
+#include "blip_buffer.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+
+// Clock positions are converted to samples in 32.32 fixed point; the top
+// PHASE_BITS of the fraction choose which of the kernels to use.
+static const uint FRAC_BITS   = 32;
+static const uint PHASE_BITS  = 6;
+static const uint PHASE_COUNT = 1 << PHASE_BITS;
+
+// Each step is spread over this many output samples.
+static const uint KERNEL_WIDTH = 16;
+
+// Kernel taps sum to 1 << DELTA_BITS, so a delta's full height has built up
+// in the running sum once the kernel has passed.
+static const uint DELTA_BITS = 14;
+
+// The running sum leaks towards zero by 1/512 each sample: a gentle
+// high-pass (around 14 Hz at 44.1 kHz) that removes the channels' DC offset.
+static const uint BASS_SHIFT = 9;
+
+using Kernel = std::array<int, KERNEL_WIDTH>;
+
+// Windowed sinc for a step PHASE_COUNTths of the way past a sample, centred
+// half a kernel in, with each kernel's taps rounded to sum exactly to one.
+static std::array<Kernel, PHASE_COUNT> make_kernels() {
+    const double PI = 3.14159265358979323846;
+    const double CUTOFF = 0.92;  // of Nyquist, leaving room for the window's roll-off
+    const double HALF = KERNEL_WIDTH / 2.0;
+
+    std::array<Kernel, PHASE_COUNT> kernels;
+
+    for (uint phase = 0; phase < PHASE_COUNT; phase++) {
+        double taps[KERNEL_WIDTH];
+        double total = 0.0;
+
+        for (uint i = 0; i < KERNEL_WIDTH; i++) {
+            double t = static_cast<double>(i) + 0.5 - HALF - static_cast<double>(phase) / PHASE_COUNT;
+            double x = PI * CUTOFF * t;
+            double sinc = (x == 0.0) ? 1.0 : std::sin(x) / x;
+            double window = 0.42 + 0.5 * std::cos(PI * t / HALF) + 0.08 * std::cos(2.0 * PI * t / HALF);
+            taps[i] = sinc * std::max(window, 0.0);
+            total += taps[i];
+        }
+
+        int sum = 0;
+        uint largest = 0;
+        for (uint i = 0; i < KERNEL_WIDTH; i++) {
+            kernels[phase][i] = static_cast<int>(std::lround(taps[i] / total * (1 << DELTA_BITS)));
+            sum += kernels[phase][i];
+            if (kernels[phase][i] > kernels[phase][largest]) largest = i;
+        }
+        kernels[phase][largest] += (1 << DELTA_BITS) - sum;
+    }
+
+    return kernels;
+}
+
+static const std::array<Kernel, PHASE_COUNT> KERNELS = make_kernels();
+
+BlipBuffer::BlipBuffer(uint max_samples)
+    : max_samples_(max_samples),
+      buffer_(max_samples + KERNEL_WIDTH, 0) {}
+
+void BlipBuffer::set_rates(double clock_rate, double sample_rate) {
+    factor_ = static_cast<u64>(std::ceil(sample_rate / clock_rate * static_cast<double>(1ull << FRAC_BITS)));
+}
+
+void BlipBuffer::add_delta(u32 clock_time, int delta) {
+    u64 position = static_cast<u64>(clock_time) * factor_ + offset_;
+    uint index = avail_ + static_cast<uint>(position >> FRAC_BITS);
+
+    // Frames running past what the buffer holds lose the overflow
+    if (index > max_samples_) return;
+
+    const Kernel& kernel = KERNELS[(position >> (FRAC_BITS - PHASE_BITS)) & (PHASE_COUNT - 1)];
+    int* out = &buffer_[index];
+
+    for (uint i = 0; i < KERNEL_WIDTH; i++) {
+        out[i] += kernel[i] * delta;
+    }
+}
+
+void BlipBuffer::end_frame(u32 clock_duration) {
+    u64 position = static_cast<u64>(clock_duration) * factor_ + offset_;
+    avail_   = std::min(max_samples_, avail_ + static_cast<uint>(position >> FRAC_BITS));
+    offset_  = position & ((1ull << FRAC_BITS) - 1);
+}
+
+u32 BlipBuffer::max_frame_cycles() const {
+    u64 room = (static_cast<u64>(max_samples_ - avail_) << FRAC_BITS) - offset_;
+    return static_cast<u32>(std::min<u64>(room / factor_, 0xFFFFFFFFu));
+}
+
+uint BlipBuffer::samples_avail() const { return avail_; }
+
+uint BlipBuffer::read_samples(s16* out, uint count, uint stride) {
+    count = std::min(count, avail_);
+
+    for (uint i = 0; i < count; i++) {
+        integrator_ += buffer_[i];
+        s64 sample = integrator_ >> DELTA_BITS;
+        integrator_ -= sample << (DELTA_BITS - BASS_SHIFT);
+        out[i * stride] = static_cast<s16>(std::max<s64>(-32768, std::min<s64>(32767, sample)));
+    }
+
+    // Keep what is left, including the tails of kernels past the frame end
+    uint remaining = avail_ - count + KERNEL_WIDTH;
+    std::memmove(buffer_.data(), buffer_.data() + count, remaining * sizeof(int));
+    std::fill(buffer_.begin() + remaining, buffer_.begin() + remaining + count, 0);
+    avail_ -= count;
+
+    return count;
+}
+
+void BlipBuffer::clear() {
+    std::fill(buffer_.begin(), buffer_.end(), 0);
+    avail_      = 0;
+    offset_     = 0;
+    integrator_ = 0;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "../definitions.h"
+
+#include <vector>
+
+// Band-limited step synthesis (after blargg's Blip_Buffer).
+//
+// Rather than point-sampling a waveform, sound sources report each change
+// in their output level as a delta at the clock cycle it happened. Each
+// delta is added to the buffer as a band-limited step, spread over a few
+// output samples by a windowed-sinc kernel picked for the step's exact
+// position between samples, so square edges come out without aliasing.
+// Output samples are the running sum of the buffer, made in bulk when read.
+class BlipBuffer {
+public:
+    // Holds up to max_samples output samples between reads.
+    explicit BlipBuffer(uint max_samples);
+
+    // Clock cycles per second in, samples per second out. The ratio can be
+    // changed between frames to stretch or squeeze the output slightly.
+    void set_rates(double clock_rate, double sample_rate);
+
+    // Adds a change of delta in output level at clock_time cycles into the
+    // current frame.
+    void add_delta(u32 clock_time, int delta);
+
+    // Ends the current frame after clock_duration cycles, making the
+    // samples before it available; the next frame starts from 0.
+    void end_frame(u32 clock_duration);
+
+    // Most cycles a frame can run before it must be ended to fit.
+    u32 max_frame_cycles() const;
+
+    uint samples_avail() const;
+
+    // Reads up to count samples into out, stride apart (2 for interleaved
+    // stereo), removing them from the buffer. Returns the number read.
+    uint read_samples(s16* out, uint count, uint stride = 1);
+
+    void clear();
+
+private:
+    u64 factor_ = 0;  // output samples per clock cycle, 32.32 fixed point
+    u64 offset_ = 0;  // fraction of a sample the current frame starts at
+
+    uint avail_      = 0;
+    uint max_samples_ = 0;
+    s64  integrator_ = 0;
+
+    std::vector<int> buffer_;
+};
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "blip_buffer.h"
+#include "../definitions.h"
+
+// Connects one channel to the left and right blip buffers. The channel
+// reports its amplitude (0–15) as it runs; only changes reach the buffers,
+// as deltas scaled by the channel's current gain on each side.
+class ChannelOutput {
+public:
+    void set_buffers(BlipBuffer* left, BlipBuffer* right) {
+        left_  = left;
+        right_ = right;
+    }
+
+    void update(u32 time, int amplitude) {
+        int delta = amplitude - amplitude_;
+        if (delta == 0) return;
+        amplitude_ = amplitude;
+        if (gain_left_)  left_->add_delta(time, delta * gain_left_);
+        if (gain_right_) right_->add_delta(time, delta * gain_right_);
+    }
+
+    // Nothing heard on either side: the channel can skip reporting.
+    bool muted() const { return gain_left_ == 0 && gain_right_ == 0; }
+
+    // Panning or master volume changed: the level being held moves to the
+    // new gain at time.
+    void set_gains(u32 time, int left, int right) {
+        if (left != gain_left_)   left_->add_delta(time, amplitude_ * (left - gain_left_));
+        if (right != gain_right_) right_->add_delta(time, amplitude_ * (right - gain_right_));
+        gain_left_  = left;
+        gain_right_ = right;
+    }
+
+private:
+    BlipBuffer* left_  = nullptr;
+    BlipBuffer* right_ = nullptr;
+
+    int amplitude_  = 0;
+    int gain_left_  = 0;
+    int gain_right_ = 0;
+};
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "../definitions.h"
+
+// Runs a channel's frequency timer over elapsed cycles in one go, rather
+// than a period at a time. The timer counts down and reloads with period
+// each time it runs out (reaching 0 counts); returns how many times it did.
+inline u32 advance_timer(int& timer, u32 period, u32 elapsed) {
+    if (timer > 0 && static_cast<u32>(timer) > elapsed) {
+        timer -= static_cast<int>(elapsed);
+        return 0;
+    }
+
+    u64 over = static_cast<u64>(static_cast<s64>(elapsed) - timer);
+    timer = static_cast<int>(period - over % period);
+    return static_cast<u32>(1 + over / period);
+}
+
+// Cycles from now until the timer has run out steps times, or negative if
+// the first is already overdue.
+inline s64 cycles_to_step(int timer, u32 period, u32 steps) {
+    return timer + static_cast<s64>(steps - 1) * period;
+}
@@ -1,9 +1,51 @@
 #include "noise_channel.h"
+#include "frequency_timer.h"
+
+#include <algorithm>
+#include <array>
 
 // Clock divisors for NR43 divisor code 0–7.
 // Code 0 uses divisor 8; codes 1–7 use code * 16.
 static const int DIVISORS[8] = {8, 16, 32, 48, 64, 80, 96, 112};
 
+// Both LFSR widths are maximal-length: the 15-bit one passes through every
+// non-zero 15-bit state before repeating, and in 7-bit mode the low 7 bits
+// step on their own through every non-zero 7-bit state. Each sequence is
+// tabled in order, with every state's place in it and how many steps it is
+// until bit 0, the output, next changes; jumping any number of steps is a
+// lookup.
+template <uint Bits>
+struct LfsrTable {
+    static const uint LENGTH = (1u << Bits) - 1;
+
+    std::array<u16, LENGTH>       states;
+    std::array<u16, LENGTH + 1>   index;
+    std::array<u8,  LENGTH>       steps_to_change;
+
+    LfsrTable() {
+        u16 lfsr = static_cast<u16>(LENGTH);
+        for (uint n = 0; n < LENGTH; n++) {
+            states[n]    = lfsr;
+            index[lfsr]  = static_cast<u16>(n);
+            u16 xor_bit  = (lfsr ^ (lfsr >> 1)) & 0x1;
+            lfsr = static_cast<u16>((lfsr >> 1) | (xor_bit << (Bits - 1)));
+        }
+        index[0] = 0;  // all zeros never moves, and is handled apart
+
+        for (uint n = 0; n < LENGTH; n++) {
+            u8 steps = 1;
+            while ((states[(n + steps) % LENGTH] & 1) == (states[n] & 1)) ++steps;
+            steps_to_change[n] = steps;
+        }
+    }
+};
+
+static const LfsrTable<15> LFSR_15;
+static const LfsrTable<7>  LFSR_7;
+
+// Far enough off never to come up within a run.
+static const uint NEVER_CHANGES = 1u << 24;
+
 void NoiseChannel::write_nr41(u8 val) {
     length_counter_ = 64 - (val & 0x3F);
 }
@@ -35,19 +77,69 @@ u8 NoiseChannel::read_nr43() const {
 }
 u8 NoiseChannel::read_nr44() const { return 0xBF | (length_enabled_ ? 0x40 : 0); }
 
-void NoiseChannel::tick(int cycles) {
+void NoiseChannel::run(u32 time, u32 end_time, ChannelOutput& out) {
+    out.update(time, amplitude());
     if (!channel_enabled_) return;
-    freq_timer_ -= cycles;
-    while (freq_timer_ <= 0) {
-        freq_timer_ += timer_period();
-        // Clock the LFSR: XOR bits 0 and 1, shift right, feed back into bit 14.
-        u8 xor_bit = (lfsr_ & 0x1) ^ ((lfsr_ >> 1) & 0x1);
-        lfsr_ >>= 1;
-        lfsr_ |= static_cast<u16>(xor_bit) << 14;
-        if (width_mode_) {
-            lfsr_ = (lfsr_ & ~(1 << 6)) | (static_cast<u16>(xor_bit) << 6);
+    u32 period = static_cast<u32>(timer_period());
+
+    // Jump from one change of output to the next; silent or unheard, there
+    // is nothing to report at all.
+    if (volume_ > 0 && !out.muted()) {
+        while (true) {
+            s64 change = cycles_to_step(freq_timer_, period, steps_to_change());
+            if (change > static_cast<s64>(end_time - time)) break;
+
+            u32 elapsed = static_cast<u32>(std::max<s64>(change, 0));
+            advance_lfsr(advance_timer(freq_timer_, period, elapsed));
+            time += elapsed;
+            out.update(time, amplitude());
         }
     }
+
+    advance_lfsr(advance_timer(freq_timer_, period, end_time - time));
+}
+
+void NoiseChannel::step_lfsr() {
+    // XOR bits 0 and 1, shift right, feed back into bit 14.
+    u8 xor_bit = (lfsr_ & 0x1) ^ ((lfsr_ >> 1) & 0x1);
+    lfsr_ >>= 1;
+    lfsr_ |= static_cast<u16>(xor_bit) << 14;
+    if (width_mode_) {
+        lfsr_ = (lfsr_ & ~(1 << 6)) | (static_cast<u16>(xor_bit) << 6);
+    }
+}
+
+void NoiseChannel::advance_lfsr(u32 steps) {
+    if (!width_mode_) {
+        if (lfsr_ == 0) return;
+        uint n = (LFSR_15.index[lfsr_] + steps) % LFSR_15.LENGTH;
+        lfsr_ = LFSR_15.states[n];
+        return;
+    }
+
+    // In 7-bit mode the top 8 bits hold the last 8 feedback bits, which the
+    // table doesn't track; jump the low 7 bits to 8 steps short, and step
+    // the rest of the way to refill them. Low bits left all zero by 15-bit
+    // mode stay that way, as does the rest after 8 steps, leaving an LFSR
+    // of all zeros that nothing moves.
+    if ((lfsr_ & 0x7F) == 0) {
+        steps = std::min(steps, 8u);
+    } else if (steps > 8) {
+        uint n = (LFSR_7.index[lfsr_ & 0x7F] + (steps - 8)) % LFSR_7.LENGTH;
+        lfsr_ = static_cast<u16>((lfsr_ & ~0x7F) | LFSR_7.states[n]);
+        steps = 8;
+    }
+    for (; steps > 0; --steps) step_lfsr();
+}
+
+uint NoiseChannel::steps_to_change() const {
+    // Stuck at zero, the output never changes
+    if (!width_mode_) {
+        if (lfsr_ == 0) return NEVER_CHANGES;
+        return LFSR_15.steps_to_change[LFSR_15.index[lfsr_]];
+    }
+    if ((lfsr_ & 0x7F) == 0) return NEVER_CHANGES;
+    return LFSR_7.steps_to_change[LFSR_7.index[lfsr_ & 0x7F]];
 }
 
 void NoiseChannel::clock_length() {
@@ -66,10 +158,10 @@ void NoiseChannel::clock_envelope() {
     }
 }
 
-float NoiseChannel::output() const {
-    if (!channel_enabled_) return 0.0f;
+int NoiseChannel::amplitude() const {
+    if (!channel_enabled_) return 0;
     // LFSR bit 0 == 1 → output 0 (silence); bit 0 == 0 → output volume.
-    return (lfsr_ & 0x1) ? 0.0f : (volume_ / 15.0f);
+    return (lfsr_ & 0x1) ? 0 : volume_;
 }
 
 bool NoiseChannel::is_enabled() const { return channel_enabled_; }
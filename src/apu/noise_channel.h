@@ -1,5 +1,6 @@
 #pragma once
 
+#include "channel_output.h"
 #include "../definitions.h"
 
 // CH4 — noise channel, driven by a 15-bit (or 7-bit) linear feedback shift register.
@@ -15,17 +16,22 @@ public:
     u8 read_nr43() const;
     u8 read_nr44() const;
 
-    void tick(int cycles);
+    void run(u32 time, u32 end_time, ChannelOutput& out);
     void clock_length();
     void clock_envelope();
 
-    float output() const;
+    // Current output level, 0–15.
+    int amplitude() const;
     bool is_enabled() const;
 
 private:
     void trigger();
     int timer_period() const;
 
+    void step_lfsr();
+    void advance_lfsr(u32 steps);
+    uint steps_to_change() const;
+
     bool channel_enabled_ = false;
 
     uint length_counter_ = 0;
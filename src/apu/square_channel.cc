@@ -1,4 +1,8 @@
 #include "square_channel.h"
+#include "frequency_timer.h"
+
+#include <algorithm>
+#include <array>
 
 // 8-step duty waveform table. Index [duty][step].
 static const u8 DUTY_TABLE[4][8] = {
@@ -8,6 +12,21 @@ static const u8 DUTY_TABLE[4][8] = {
     {0, 1, 1, 1, 1, 1, 1, 0},  // 75 %
 };
 
+// Steps from each duty position until the output next changes level.
+static std::array<std::array<u8, 8>, 4> make_steps_to_edge() {
+    std::array<std::array<u8, 8>, 4> steps;
+    for (uint duty = 0; duty < 4; duty++) {
+        for (uint pos = 0; pos < 8; pos++) {
+            u8 n = 1;
+            while (DUTY_TABLE[duty][(pos + n) & 7] == DUTY_TABLE[duty][pos]) ++n;
+            steps[duty][pos] = n;
+        }
+    }
+    return steps;
+}
+
+static const std::array<std::array<u8, 8>, 4> STEPS_TO_EDGE = make_steps_to_edge();
+
 SquareChannel::SquareChannel(bool has_sweep) : has_sweep_(has_sweep) {}
 
 void SquareChannel::write_nr0(u8 val) {
@@ -55,12 +74,25 @@ u8 SquareChannel::read_nr2() const {
 u8 SquareChannel::read_nr3() const { return 0xFF; }  // write-only
 u8 SquareChannel::read_nr4() const { return 0xBF | (length_enabled_ ? 0x40 : 0); }
 
-void SquareChannel::tick(int cycles) {
-    freq_timer_ -= cycles;
-    while (freq_timer_ <= 0) {
-        duty_pos_   = (duty_pos_ + 1) & 7;
-        freq_timer_ += static_cast<int>(2048 - freq_) * 4;
+void SquareChannel::run(u32 time, u32 end_time, ChannelOutput& out) {
+    out.update(time, amplitude());
+    u32 period = (2048 - freq_) * 4;
+
+    // Only edges of the duty waveform change the level, so jump from one to
+    // the next. Silent or unheard, there is nothing to report at all.
+    if (channel_enabled_ && volume_ > 0 && !out.muted()) {
+        while (true) {
+            s64 edge = cycles_to_step(freq_timer_, period, STEPS_TO_EDGE[duty_][duty_pos_]);
+            if (edge > static_cast<s64>(end_time - time)) break;
+
+            u32 elapsed = static_cast<u32>(std::max<s64>(edge, 0));
+            duty_pos_ = (duty_pos_ + advance_timer(freq_timer_, period, elapsed)) & 7;
+            time += elapsed;
+            out.update(time, amplitude());
+        }
     }
+
+    duty_pos_ = (duty_pos_ + advance_timer(freq_timer_, period, end_time - time)) & 7;
 }
 
 void SquareChannel::clock_length() {
@@ -96,9 +128,9 @@ void SquareChannel::clock_envelope() {
     }
 }
 
-float SquareChannel::output() const {
-    if (!channel_enabled_) return 0.0f;
-    return DUTY_TABLE[duty_][duty_pos_] ? (volume_ / 15.0f) : 0.0f;
+int SquareChannel::amplitude() const {
+    if (!channel_enabled_) return 0;
+    return DUTY_TABLE[duty_][duty_pos_] ? volume_ : 0;
 }
 
 bool SquareChannel::is_enabled() const { return channel_enabled_; }
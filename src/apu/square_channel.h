@@ -1,5 +1,6 @@
 #pragma once
 
+#include "channel_output.h"
 #include "../definitions.h"
 
 // Handles CH1 (square + frequency sweep) and CH2 (square, no sweep).
@@ -22,15 +23,17 @@ public:
     u8 read_nr3() const;
     u8 read_nr4() const;
 
-    // Called each CPU step; cycles is the number of T-cycles elapsed.
-    void tick(int cycles);
+    // Runs the channel from time to end_time (cycles into the current audio
+    // frame), reporting each change of level to out as it happens.
+    void run(u32 time, u32 end_time, ChannelOutput& out);
 
     // Frame-sequencer clocks (called by APU at the correct rates).
     void clock_length();    // 256 Hz
     void clock_sweep();     // 128 Hz, CH1 only
     void clock_envelope();  // 64 Hz
 
-    float output() const;
+    // Current output level, 0–15.
+    int amplitude() const;
     bool is_enabled() const;
 
 private:
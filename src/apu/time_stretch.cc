@@ -0,0 +1,83 @@
+#include "time_stretch.h"
+
+#include <algorithm>
+#include <cmath>
+
+void TimeStretch::begin_stretch() {
+    // A stretch too short to join is dropped.
+    if (joining_) pending_.resize(join_ * 2);
+
+    join_    = static_cast<uint>(pending_.size() / 2);
+    joining_ = true;
+}
+
+uint TimeStretch::process(const s16* in, uint count, s16* out) {
+    pending_.insert(pending_.end(), in, in + count * 2);
+    uint frames = static_cast<uint>(pending_.size() / 2);
+
+    if (joining_) {
+        // Wait for enough of the new stretch to search and fade into.
+        if (frames < join_ + SEEK + OVERLAP) return 0;
+        join();
+        frames = static_cast<uint>(pending_.size() / 2);
+    }
+
+    if (frames <= OVERLAP) return 0;
+
+    uint ready = frames - OVERLAP;
+    std::copy(pending_.begin(), pending_.begin() + ready * 2, out);
+    pending_.erase(pending_.begin(), pending_.begin() + ready * 2);
+    return ready;
+}
+
+void TimeStretch::reset() {
+    pending_.clear();
+    join_    = 0;
+    joining_ = false;
+}
+
+void TimeStretch::join() {
+    joining_ = false;
+
+    uint overlap = join_ < OVERLAP ? join_ : OVERLAP;
+    if (overlap == 0) return;
+
+    s16*       tail  = &pending_[(join_ - overlap) * 2];
+    const s16* fresh = &pending_[join_ * 2];
+
+    // Find where the new stretch best continues the old one: the offset
+    // with the highest correlation between the two, mixed to mono, taken
+    // over the new stretch's energy so loud passages don't win by default.
+    uint   best       = 0;
+    double best_score = -1e300;
+
+    for (uint offset = 0; offset <= SEEK; offset++) {
+        double correlation = 0.0;
+        double energy      = 1.0;
+        for (uint n = 0; n < overlap; n++) {
+            double a = tail[n * 2] + tail[n * 2 + 1];
+            double b = fresh[(offset + n) * 2] + fresh[(offset + n) * 2 + 1];
+            correlation += a * b;
+            energy      += b * b;
+        }
+
+        double score = correlation / std::sqrt(energy);
+        if (score > best_score) {
+            best_score = score;
+            best       = offset;
+        }
+    }
+
+    // Fade the old stretch out as the new one fades in, then drop the part
+    // of the new stretch that was skipped or faded in.
+    for (uint n = 0; n < overlap; n++) {
+        for (uint c = 0; c < 2; c++) {
+            int a = tail[n * 2 + c];
+            int b = fresh[(best + n) * 2 + c];
+            tail[n * 2 + c] = static_cast<s16>((a * static_cast<int>(overlap - n) + b * static_cast<int>(n))
+                                               / static_cast<int>(overlap));
+        }
+    }
+
+    pending_.erase(pending_.begin() + join_ * 2, pending_.begin() + (join_ + best + overlap) * 2);
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "../definitions.h"
+
+#include <vector>
+
+// Joins stretches of sound with gaps cut out of them back together without
+// changing their pitch (WSOLA, waveform-similarity overlap-add). While
+// fast-forwarding, the APU only makes sound for some audio frames and skips
+// the rest; each time it starts again, the end of what it made last is
+// cross-faded into the new stretch, at the offset into it where the two
+// waveforms line up best, so the seams neither click nor beat.
+class TimeStretch {
+public:
+    static const uint OVERLAP = 128;  // frames cross-faded at each seam, ~3 ms
+    static const uint SEEK    = 256;  // furthest into the new stretch to look
+
+    // Most frames process() can hand out beyond those passed in.
+    static const uint MAX_HELD = 2 * OVERLAP + SEEK;
+
+    // Marks the next frames passed in as the start of a new stretch.
+    void begin_stretch();
+
+    // Takes count interleaved stereo frames, and writes what is ready to
+    // out, returning how many frames that is. The last OVERLAP frames are
+    // always held back, for the next seam.
+    uint process(const s16* in, uint count, s16* out);
+
+    // Drops anything held back.
+    void reset();
+
+private:
+    void join();
+
+    std::vector<s16> pending_;  // interleaved frames not yet handed out
+    uint join_    = 0;          // frame in pending_ the new stretch starts at
+    bool joining_ = false;
+};
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "audio_buffer.h"
+#include "audio_sink.h"
+#include "../definitions.h"
+#include "../util/wake_signal.h"
+
+#include <atomic>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Records to a 16-bit stereo WAV file. Samples go through a ring to a
+// writer thread, which does the I/O, so a slow disk never holds up
+// emulation; if the writer falls far enough behind for the ring to fill,
+// samples are dropped and counted instead.
+class WavFileSink : public AudioSink {
+public:
+    explicit WavFileSink(const std::string& path);
+    ~WavFileSink() override;
+
+    void write(const s16* samples, size_t count) override;
+
+    // Waits for queued samples to be written, then fills in the header's
+    // sizes and closes the file. Called by the destructor if not before.
+    void finish();
+
+    u64 frames_written() const { return written_.load(std::memory_order_relaxed); }
+    u64 frames_dropped() const { return queue_.overrun_frames(); }
+
+private:
+    void writer_loop();
+    void drain();
+    void write_header(u32 data_bytes);
+
+    FILE* file_;
+    AudioBuffer queue_;       // ~1.5 s of sound, for the writer to fall behind by
+    std::vector<s16> chunk_;  // writer thread's staging for fwrite
+
+    // Wakes the writer for samples queued, or to finish up.
+    WakeSignal samples_ready_;
+
+    std::atomic<bool> stopping_ = {false};
+    std::atomic<u64>  written_  = {0};
+
+    std::thread writer_;
+};
@@ -1,4 +1,7 @@
 #include "wave_channel.h"
+#include "frequency_timer.h"
+
+#include <algorithm>
 
 void WaveChannel::write_nr30(u8 val) {
     dac_enabled_ = (val & 0x80) != 0;
@@ -32,13 +35,22 @@ u8 WaveChannel::read_nr34() const { return 0xBF | (length_enabled_ ? 0x40 : 0);
 void WaveChannel::write_wave_ram(u8 offset, u8 val) { wave_ram_[offset] = val; }
 u8   WaveChannel::read_wave_ram(u8 offset)   const  { return wave_ram_[offset]; }
 
-void WaveChannel::tick(int cycles) {
+void WaveChannel::run(u32 time, u32 end_time, ChannelOutput& out) {
+    out.update(time, amplitude());
     if (!channel_enabled_) return;
-    freq_timer_ -= cycles;
-    while (freq_timer_ <= 0) {
-        position_   = (position_ + 1) & 31;
-        freq_timer_ += static_cast<int>(2048 - freq_) * 2;
+    u32 period = (2048 - freq_) * 2;
+
+    // Each step can play a different sample, unless muted or unheard.
+    if (output_level_ != 0 && !out.muted()) {
+        while (freq_timer_ <= static_cast<s64>(end_time - time)) {
+            u32 elapsed = static_cast<u32>(std::max(freq_timer_, 0));
+            position_ = (position_ + advance_timer(freq_timer_, period, elapsed)) & 31;
+            time += elapsed;
+            out.update(time, amplitude());
+        }
     }
+
+    position_ = (position_ + advance_timer(freq_timer_, period, end_time - time)) & 31;
 }
 
 void WaveChannel::clock_length() {
@@ -47,13 +59,13 @@ void WaveChannel::clock_length() {
     }
 }
 
-float WaveChannel::output() const {
-    if (!channel_enabled_ || !dac_enabled_ || output_level_ == 0) return 0.0f;
+int WaveChannel::amplitude() const {
+    if (!channel_enabled_ || !dac_enabled_ || output_level_ == 0) return 0;
     u8 byte   = wave_ram_[position_ / 2];
     u8 nibble = (position_ & 1) ? (byte & 0x0F) : (byte >> 4);
     // shift right by 0, 1, or 2 for levels 1–3; mute (0) already handled above.
     static const u8 SHIFTS[4] = {4, 0, 1, 2};
-    return static_cast<float>(nibble >> SHIFTS[output_level_]) / 15.0f;
+    return nibble >> SHIFTS[output_level_];
 }
 
 bool WaveChannel::is_enabled() const { return channel_enabled_; }
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "channel_output.h"
 #include "../definitions.h"
 #include <array>
 
@@ -21,10 +22,11 @@ public:
     void write_wave_ram(u8 offset, u8 val);
     u8   read_wave_ram(u8 offset) const;
 
-    void tick(int cycles);
+    void run(u32 time, u32 end_time, ChannelOutput& out);
     void clock_length();
 
-    float output() const;
+    // Current output level, 0–15.
+    int amplitude() const;
     bool is_enabled() const;
 
 private:
@@ -17,6 +17,7 @@ public:
     virtual void write(const Address& address, u8 value) = 0;
 
     auto get_cartridge_ram() const -> const std::vector<u8>&;
+    auto get_info() const -> const CartridgeInfo& { return *cartridge_info; }
 
 protected:
     std::vector<u8> rom;
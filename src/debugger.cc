@@ -307,14 +307,3 @@ auto Debugger::parse_command(std::string cmd) -> CommandType {
 
     return CommandType::Unknown;
 }
-
-void Debugger::command_breakaddr(Args args) {
-    if (args.size() != 1) {
-        log_error("Invalid arguments to command");
-        return;
-    }
-
-    breakpoint_addr = static_cast<u16>(std::stoul(args[0], nullptr, 16));
-    debugger_enabled = false;
-    log_info("Breakpoint set at address 0x%04X", breakpoint_addr);
-}
\ No newline at end of file
@@ -7,8 +7,12 @@ using uint = unsigned int;
 
 using u8 = u_int8_t;
 using u16 = u_int16_t;
+using u32 = u_int32_t;
+using u64 = u_int64_t;
 using s8 = int8_t;
 using s16 = int16_t;
+using s32 = int32_t;
+using s64 = int64_t;
 
 struct Noncopyable {
     auto operator=(const Noncopyable&) -> Noncopyable& = delete;
@@ -33,27 +37,14 @@ const uint BG_MAP_SIZE = 256;
 
 const int CLOCK_RATE = 4194304; // 4.194304 MHz
 
-enum class GBColor {
-    Color0, // White
-    Color1, // Light Gray
-    Color2, // Dark Gray
-    Color3, // Black
-};
-
-enum class Color {
+/* Screen shades, numbered as in the DMG palette registers */
+enum class Color : u8 {
     White,
     LightGray,
     DarkGray,
     Black,
 };
 
-struct Palette {
-    Color color0 = Color::White;
-    Color color1 = Color::LightGray;
-    Color color2 = Color::DarkGray;
-    Color color3 = Color::Black;
-};
-
 class Cycles {
 public:
     Cycles(uint nCycles) : cycles(nCycles) {}
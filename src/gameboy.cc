@@ -1,12 +1,17 @@
 #include "gameboy.h"
 #include "cartridge/cartridge.h"
 
+#include <limits>
+
+static const u64 NEVER_CYCLE = std::numeric_limits<u64>::max();
+
 Gameboy::Gameboy(const std::vector<u8>& cartridge_data, Options& options, const std::vector<u8>& save_data) :
     cartridge(get_cartridge(cartridge_data, save_data)),
     cpu(*this, options),
+    apu(options.audio_thread ? nullptr : options.audio_sink),
     video(*this, options),
     mmu(*this, options),
-    timer(*this),
+    timer(elapsed_cycles, cpu.interrupt_flag),
     serial(options),
     debugger(*this, options)
 {
@@ -14,18 +19,36 @@ Gameboy::Gameboy(const std::vector<u8>& cartridge_data, Options& options, const
         ? LogLevel::Error
         : (options.trace ? LogLevel::Trace : LogLevel::Info)
     );
+
+    if (options.audio_thread && options.audio_sink && options.audio_sink->wants_samples()) {
+        apu_thread = std::make_unique<ApuThread>(options.audio_sink);
+    }
 }
 
-void Gameboy::run(
-    const should_close_callback_t& _should_close_callback,
-    const vblank_callback_t& _vblank_callback)
-{
-    should_close_callback = _should_close_callback;
-    video.register_vblank_callback(_vblank_callback);
+auto Gameboy::run_frame() -> const FrameBuffer& {
+    const FrameBuffer* frame;
+    while (!(frame = video.take_finished_frame())) {
+        run_to_event(NEVER_CYCLE);
+    }
+
+    last_frame = frame;
+    return *frame;
+}
 
-    while (!should_close_callback()) {
-        tick();
+auto Gameboy::run_cycles(u64 cycles) -> uint {
+    u64 stop_cycle = elapsed_cycles + cycles;
+    uint frames = 0;
+
+    while (elapsed_cycles < stop_cycle) {
+        run_to_event(stop_cycle);
+
+        if (const FrameBuffer* frame = video.take_finished_frame()) {
+            last_frame = frame;
+            frames++;
+        }
     }
+
+    return frames;
 }
 
 void Gameboy::button_pressed(GbButton button) {
@@ -36,6 +59,14 @@ void Gameboy::button_released(GbButton button) {
     input.button_released(button);
 }
 
+void Gameboy::set_render_interval(uint frames) {
+    video.set_render_interval(frames);
+}
+
+void Gameboy::request_frame() {
+    video.request_frame();
+}
+
 void Gameboy::debug_toggle_background() {
     video.debug_disable_background = !video.debug_disable_background;
 }
@@ -52,14 +83,54 @@ auto Gameboy::get_cartridge_ram() const -> const std::vector<u8>& {
     return cartridge->get_cartridge_ram();
 }
 
-auto Gameboy::get_audio_buffer() -> AudioBuffer& {
-    return apu.get_buffer();
+void Gameboy::flush_audio() {
+    apu.catch_up(elapsed_cycles);
+    apu.end_frame();
+
+    if (apu_thread) { apu_thread->flush(elapsed_cycles); }
+}
+
+void Gameboy::set_audio_rate_control(bool enabled) {
+    if (apu_thread) {
+        apu_thread->set_rate_control(enabled);
+    } else {
+        apu.set_rate_control(enabled);
+    }
 }
 
-void Gameboy::tick() {
-    Cycles cycles = cpu.tick();
-    apu.tick(static_cast<int>(cycles.cycles));
-    video.tick(cycles);
-    timer.tick(cycles.cycles);
-    elapsed_cycles += cycles.cycles;
+auto Gameboy::get_audio_telemetry() const -> AudioTelemetry {
+    return apu_thread ? apu_thread->telemetry() : apu.telemetry();
+}
+
+void Gameboy::set_speed(uint speed) {
+    if (apu_thread) {
+        apu_thread->set_speed(speed);
+    } else {
+        apu.set_speed(speed);
+    }
+}
+
+void Gameboy::wait_for_audio() {
+    if (apu_thread) { apu_thread->wait(); }
+}
+
+/* Between events nothing but the CPU does anything, so instructions run
+ * back to back with no more than a comparison with each event's time. An
+ * instruction can move an event, by writing a register, so they are read
+ * afresh each time round. It can also finish a frame, by switching the LCD
+ * off in VBlank, which must be handed over before the next one replaces it. */
+void Gameboy::run_to_event(u64 stop_cycle) {
+    while (elapsed_cycles < stop_cycle
+            && elapsed_cycles < video.next_event_cycle()
+            && elapsed_cycles < timer.next_event_cycle()
+            && !video.frame_finished()) {
+        elapsed_cycles += cpu.tick().cycles;
+    }
+
+    if (elapsed_cycles >= video.next_event_cycle()) {
+        video.catch_up(elapsed_cycles);
+    }
+    if (elapsed_cycles >= timer.next_event_cycle()) {
+        timer.catch_up(elapsed_cycles);
+    }
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "apu/apu.h"
+#include "apu/apu_thread.h"
 #include "debugger.h"
 #include "input.h"
 #include "cpu/cpu.h"
@@ -11,39 +12,71 @@
 #include "util/log.h"
 
 #include <memory>
-#include <functional>
-
-using should_close_callback_t = std::function<bool()>;
 
 class Gameboy {
 public:
     Gameboy(const std::vector<u8>& cartridge_data, Options& options,
             const std::vector<u8>& save_data = {});
 
-    void run(
-        const should_close_callback_t& _should_close_callback,
-        const vblank_callback_t& _vblank_callback
-    );
+    /* The host owns the loop, and calls one of these to run for a while.
+     * Exit conditions are only checked between PPU and timer events. */
+
+    /* Runs until the next frame is finished, and returns it */
+    auto run_frame() -> const FrameBuffer&;
+
+    /* Runs for the given number of cycles, or the instruction that takes
+     * them past it. Returns how many frames were finished on the way. */
+    auto run_cycles(u64 cycles) -> uint;
+
+    /* Runs whole frames until done returns true for one */
+    template <typename Predicate>
+    void run_until(Predicate&& done) {
+        while (!done(run_frame())) {}
+    }
+
+    /* The frame last finished, or null before the first */
+    auto get_last_frame() const -> const FrameBuffer* { return last_frame; }
 
     void button_pressed(GbButton button);
     void button_released(GbButton button);
 
+    /* Render one frame in every N, or with 0 only requested frames */
+    void set_render_interval(uint frames);
+    void request_frame();
+
     void debug_toggle_background();
     void debug_toggle_sprites();
     void debug_toggle_window();
 
     auto get_cartridge_ram() const -> const std::vector<u8>&;
-    auto get_audio_buffer() -> AudioBuffer&;
+    /* Brings audio up to the present and hands it to the sink given in
+     * Options. Call from the emulation thread, typically once a frame. */
+    void flush_audio();
+
+    /* For frontends playing audio in real time: see APU::set_rate_control */
+    void set_audio_rate_control(bool enabled);
+    auto get_audio_telemetry() const -> AudioTelemetry;
+
+    /* How many times faster than real time the frontend is running, 0 for
+     * uncapped, so that sound keeps pace: see APU::set_speed */
+    void set_speed(uint speed);
+
+    /* Blocks until sound made on the audio thread has all reached the sink.
+     * Returns at once without one. */
+    void wait_for_audio();
 
 private:
-    void tick();
+    void run_to_event(u64 stop_cycle);
 
     std::shared_ptr<Cartridge> cartridge;
 
     CPU cpu;
     friend class CPU;
 
+    /* With an audio thread, it synthesises the sound from a log of register
+     * writes, and apu, with no sink, only answers register reads */
     APU apu;
+    std::unique_ptr<ApuThread> apu_thread;
     friend class APU;
 
     Video video;
@@ -61,7 +94,8 @@ private:
     Debugger debugger;
     friend class Debugger;
 
-    uint elapsed_cycles = 0;
+    /* Master clock: cycles run since power on */
+    u64 elapsed_cycles = 0;
 
-    should_close_callback_t should_close_callback;
+    const FrameBuffer* last_frame = nullptr;
 };
\ No newline at end of file
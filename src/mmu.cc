@@ -10,7 +10,6 @@ MMU::MMU(Gameboy& inGb, Options& inOptions) :
     options(inOptions)
 {
     work_ram = std::vector<u8>(0x8000);
-    oam_ram = std::vector<u8>(0xA0);
     high_ram = std::vector<u8>(0x80);
 }
 
@@ -43,7 +42,7 @@ auto MMU::read(const Address& address) const -> u8 {
 
     // OAM
     if (address.in_range(0xFE00, 0xFE9F)) {
-        return oam_ram.at(address.value() - 0xFE00);
+        return gb.video.read_oam(address.value() - 0xFE00);
     }
 
     if (address.in_range(0xFEA0, 0xFEFF)) {
@@ -89,6 +88,7 @@ auto MMU::read_io(const Address& address) const -> u8 {
         case 0xFF34: case 0xFF35: case 0xFF36: case 0xFF37:
         case 0xFF38: case 0xFF39: case 0xFF3A: case 0xFF3B:
         case 0xFF3C: case 0xFF3D: case 0xFF3E: case 0xFF3F:
+            gb.apu.catch_up(gb.elapsed_cycles);
             return gb.apu.read(address);
 
         // Video registers
@@ -148,7 +148,7 @@ void MMU::write(const Address& address, const u8 byte) {
 
     // OAM
     if (address.in_range(0xFE00, 0xFE9F)) {
-        oam_ram.at(address.value() - 0xFE00) = byte;
+        gb.video.write_oam(address.value() - 0xFE00, byte);
         return;
     }
 
@@ -178,6 +178,9 @@ void MMU::write(const Address& address, const u8 byte) {
 }
 
 void MMU::write_io(const Address& address, const u8 byte) {
+    /* The accurate PPU has to draw up to now with the old values first */
+    if (address.in_range(0xFF40, 0xFF4B)) { gb.video.catch_up_pixels(); }
+
     switch (address.value()) {
         case 0xFF00: gb.input.write(byte); break;
         case 0xFF01: gb.serial.write(byte); break;
@@ -198,10 +201,13 @@ void MMU::write_io(const Address& address, const u8 byte) {
         case 0xFF34: case 0xFF35: case 0xFF36: case 0xFF37:
         case 0xFF38: case 0xFF39: case 0xFF3A: case 0xFF3B:
         case 0xFF3C: case 0xFF3D: case 0xFF3E: case 0xFF3F:
-            gb.apu.write(address, byte); break;
+            gb.apu.catch_up(gb.elapsed_cycles);
+            gb.apu.write(address, byte);
+            if (gb.apu_thread) { gb.apu_thread->write(gb.elapsed_cycles, address, byte); }
+            break;
 
         // Video registers
-        case 0xFF40: gb.video.lcd_control.set(byte);
+        case 0xFF40: gb.video.write_lcd_control(byte);
             fprintf(stderr, "[LCDC] = 0x%02X\n", byte);
             break;
         case 0xFF41: gb.video.lcd_status.set(byte); break;
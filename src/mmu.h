@@ -31,7 +31,6 @@ private:
     Options& options;
 
     std::vector<u8> work_ram;
-    std::vector<u8> oam_ram;
     std::vector<u8> high_ram;
 
     ByteRegister disable_boot_rom_switch;
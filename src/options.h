@@ -1,10 +1,25 @@
 #pragma once
 
+#include "definitions.h"
+
+class AudioSink;
+
+enum class PpuAccuracy {
+    Auto, /* As the compatibility list says, or the build's default */
+    Fast, /* Whole scanlines at once, with fixed mode 3 timing */
+    Accurate, /* Pixel FIFO run dot by dot, with variable mode 3 timing */
+};
+
 struct Options {
     bool debugger = false;
     bool trace = false;
     bool disable_logs = false;
-    bool headless = false;
+    bool headless = false; /* Frames are only rendered when requested */
+    uint render_interval = 1; /* Render one frame in every N */
+    bool render_thread = false; /* Draw on a second thread, a frame behind (fast PPU only) */
+    PpuAccuracy ppu_accuracy = PpuAccuracy::Auto;
+    AudioSink* audio_sink = nullptr; /* Where sound goes; none skips synthesising it */
+    bool audio_thread = false; /* Synthesise sound on a second thread */
     bool show_full_framebuffer = false;
     bool exit_on_infinite_jr = false;
     bool print_serial = false;
@@ -1,71 +1,141 @@
 #include "timer.h"
 
 #include "definitions.h"
-#include "gameboy.h"
-#include "cpu/cpu.h"
 #include "util/bitwise.h"
+#include "util/log.h"
 
-const uint CLOCKS_PER_CYCLE = 4;
-
-Timer::Timer(Gameboy& _gb) : gb(_gb) {}
-
-void Timer::tick(uint cycles) {
-    u8 new_divider = static_cast<u8>(divider.value() + cycles);
-    divider.set(new_divider);
-
-    clocks += cycles * CLOCKS_PER_CYCLE;
+#include <limits>
 
-    auto timer_is_on = timer_control.check_bit(2);
-    if (timer_is_on == 0) { return; }
-
-    auto clock_limit = clocks_needed_to_increment();
+const uint CLOCKS_PER_CYCLE = 4;
 
-    if (clocks >= clock_limit) {
-        clocks = clocks % clock_limit;
+const u64 NEVER = std::numeric_limits<u64>::max();
 
-        u8 old_timer_counter = timer_counter.value();
-        timer_counter.increment();
+Timer::Timer(const u64& _clock, ByteRegister& _interrupt_flag) :
+    clock(_clock),
+    interrupt_flag(_interrupt_flag)
+{
+    schedule_overflow();
+}
 
-        if (timer_counter.value() < old_timer_counter) {
-            gb.cpu.interrupt_flag.set_bit_to(2, true);
-            timer_counter.set(timer_modulo.value());
-        }
+void Timer::catch_up(u64 cycle) {
+    while (next_overflow <= cycle) {
+        /* TIMA has just gone from 0xFF: it starts again from TMA */
+        u64 overflow = next_overflow;
+        timer_value = timer_modulo.value();
+        timer_base = overflow;
+        interrupt_flag.set_bit_to(2, true);
+        schedule_overflow();
     }
 }
 
-auto Timer::get_divider() const -> u8 { return divider.value(); }
+auto Timer::get_divider() const -> u8 {
+    return static_cast<u8>(system_counter(clock) >> 8);
+}
 
-auto Timer::get_timer() const -> u8 { return timer_counter.value(); }
+auto Timer::get_timer() const -> u8 { return timer_at(clock); }
 
 auto Timer::get_timer_modulo() const -> u8 { return timer_modulo.value(); }
 
 // Only the bottom three bits of this register are usable
-auto Timer::get_timer_control() const -> u8 { return timer_control.value() & 0x3; }
+auto Timer::get_timer_control() const -> u8 { return 0xF8 | (timer_control.value() & 0x7); }
 
 void Timer::reset_divider() {
-    divider.set(0x0);
+    u64 now = clock;
+    catch_up(now);
+    rebase_timer(now);
+
+    /* If the bit TIMA follows was set, clearing it is a falling edge */
+    if (timer_signal(now)) { increment_timer(); }
+
+    divider_base = now;
+    schedule_overflow();
 }
 
 void Timer::set_timer(u8 value) {
-    timer_counter.set(value);
+    u64 now = clock;
+    catch_up(now);
+
+    timer_value = value;
+    timer_base = now;
+    schedule_overflow();
 }
 
 void Timer::set_timer_modulo(u8 value) {
+    catch_up(clock);
     timer_modulo.set(value);
 }
 
 void Timer::set_timer_control(u8 value) {
+    u64 now = clock;
+    catch_up(now);
+    rebase_timer(now);
+
+    /* TIMA follows the selected bit ANDed with the enable bit, so turning
+     * the timer off or picking another bit while that was 1 is a falling
+     * edge too */
+    bool was_high = timer_signal(now);
     timer_control.set(value);
+    if (was_high && !timer_signal(now)) { increment_timer(); }
+
+    schedule_overflow();
 }
 
-uint Timer::clocks_needed_to_increment() {
-    using bitwise::check_bit;
+/* The counter runs at the T-cycle clock, CLOCKS_PER_CYCLE per cycle */
+auto Timer::system_counter(u64 cycle) const -> u64 {
+    return (cycle - divider_base) * CLOCKS_PER_CYCLE;
+}
+
+auto Timer::timer_at(u64 cycle) const -> u8 {
+    if (!timer_is_on()) { return timer_value; }
 
-    switch (get_timer_control()) {
+    /* Falling edges of the selected bit come each time the counter passes a
+     * multiple of the period. Overflows have all been handled by now. */
+    u64 period = timer_period();
+    u64 edges = system_counter(cycle) / period - system_counter(timer_base) / period;
+    return static_cast<u8>(timer_value + edges);
+}
+
+auto Timer::timer_is_on() const -> bool { return timer_control.check_bit(2); }
+
+auto Timer::timer_period() const -> u64 {
+    switch (timer_control.value() & 0x3) {
         case 0: return CLOCK_RATE / 4096;
         case 1: return CLOCK_RATE / 262144;
         case 2: return CLOCK_RATE / 65536;
         case 3: return CLOCK_RATE / 16384;
         default: fatal_error("Invalid calculation in timer");
     }
-}
\ No newline at end of file
+}
+
+/* The counter bit TIMA follows, half a period, gated by the enable bit */
+auto Timer::timer_signal(u64 cycle) const -> bool {
+    return timer_is_on() && (system_counter(cycle) & (timer_period() / 2)) != 0;
+}
+
+void Timer::rebase_timer(u64 cycle) {
+    timer_value = timer_at(cycle);
+    timer_base = cycle;
+}
+
+void Timer::increment_timer() {
+    if (timer_value == 0xFF) {
+        timer_value = timer_modulo.value();
+        interrupt_flag.set_bit_to(2, true);
+    } else {
+        timer_value++;
+    }
+}
+
+void Timer::schedule_overflow() {
+    if (!timer_is_on()) {
+        next_overflow = NEVER;
+        return;
+    }
+
+    /* The edge that takes TIMA past 0xFF, counted from the first one after
+     * timer_base, converted back from counter ticks to cycles */
+    u64 period = timer_period();
+    u64 first_edge = (system_counter(timer_base) / period + 1) * period;
+    u64 overflow_edge = first_edge + (0xFFu - timer_value) * period;
+    next_overflow = divider_base + (overflow_edge + CLOCKS_PER_CYCLE - 1) / CLOCKS_PER_CYCLE;
+}
@@ -3,13 +3,20 @@
 #include "definitions.h"
 #include "register.h"
 
-class Gameboy;
-
+/* DIV and TIMA are never stepped. DIV is the top of a system counter that
+ * counts up from the last time DIV was reset, and TIMA counts the falling
+ * edges of the counter bit TAC selects since it was last set, so both are
+ * worked out from the master clock when read. The only thing that happens
+ * by itself is TIMA overflowing: next_event_cycle() is when it next will,
+ * and catch_up() reloads it from TMA and raises the interrupt. */
 class Timer {
 public:
-    Timer(Gameboy& inGb);
+    /* Reads the master clock through clock, and raises its interrupt in
+     * interrupt_flag */
+    Timer(const u64& clock, ByteRegister& interrupt_flag);
 
-    void tick(uint cycles);
+    auto next_event_cycle() const -> u64 { return next_overflow; }
+    void catch_up(u64 cycle);
 
     auto get_divider() const -> u8;
     auto get_timer() const -> u8;
@@ -22,15 +29,28 @@ public:
     void set_timer_control(u8 value);
 
 private:
-    uint clocks_needed_to_increment();
+    auto system_counter(u64 cycle) const -> u64;
+    auto timer_at(u64 cycle) const -> u8;
+    auto timer_is_on() const -> bool;
+    auto timer_period() const -> u64;
+    auto timer_signal(u64 cycle) const -> bool;
+
+    void rebase_timer(u64 cycle);
+    void increment_timer();
+    void schedule_overflow();
+
+    const u64& clock;
+    ByteRegister& interrupt_flag;
 
-    uint clocks = 0;
+    /* Cycle the system counter was last reset at */
+    u64 divider_base = 0;
 
-    Gameboy& gb;
+    /* TIMA as it stood at timer_base; edges since are added on read */
+    u8 timer_value = 0;
+    u64 timer_base = 0;
 
-    ByteRegister divider;
-    ByteRegister timer_counter;
+    u64 next_overflow = 0;
 
     ByteRegister timer_modulo;
     ByteRegister timer_control;
-};
\ No newline at end of file
+};
@@ -0,0 +1,102 @@
+#include "hash.h"
+
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace hash {
+
+static const u64 MULTIPLIER = 0x9E3779B97F4A7C15ULL;
+
+static const size_t LANES = 4;
+static const size_t STRIPE_BYTES = LANES * sizeof(u64);
+
+/* Mixed into each lane's words, so equal words in different lanes differ */
+alignas(32) static const u64 LANE_KEYS[LANES] = {
+    0xBE4BA423396CFEB8ULL, 0x1CAD21F72C81017CULL, 0xDB979083E96DD4DEULL, 0x1F67B3B7A4A44072ULL,
+};
+
+static inline auto mix(u64 h, u64 value) -> u64 {
+    h = (h ^ value) * MULTIPLIER;
+    return h ^ (h >> 32);
+}
+
+/* Each lane adds in its word and the product of the word's two halves, once
+ * keyed. The lanes never depend on each other, so a stripe is one step of
+ * 32x32-bit multiplies, which SSE2 and AVX2 both have. */
+static void accumulate_stripes(const u8* data, size_t stripes, u64* acc) {
+    size_t stripe = 0;
+
+#if defined(__AVX2__)
+    __m256i keys = _mm256_load_si256(reinterpret_cast<const __m256i*>(LANE_KEYS));
+    __m256i sums = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(acc));
+
+    for (; stripe < stripes; stripe++) {
+        __m256i words = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&data[stripe * STRIPE_BYTES]));
+        __m256i keyed = _mm256_xor_si256(words, keys);
+        __m256i product = _mm256_mul_epu32(keyed, _mm256_srli_epi64(keyed, 32));
+        sums = _mm256_add_epi64(sums, _mm256_add_epi64(product, words));
+    }
+
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(acc), sums);
+#elif defined(__SSE2__)
+    __m128i keys[2];
+    __m128i sums[2];
+    for (uint half = 0; half < 2; half++) {
+        keys[half] = _mm_load_si128(reinterpret_cast<const __m128i*>(&LANE_KEYS[half * 2]));
+        sums[half] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&acc[half * 2]));
+    }
+
+    for (; stripe < stripes; stripe++) {
+        for (uint half = 0; half < 2; half++) {
+            __m128i words = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&data[stripe * STRIPE_BYTES + half * 16]));
+            __m128i keyed = _mm_xor_si128(words, keys[half]);
+            __m128i product = _mm_mul_epu32(keyed, _mm_srli_epi64(keyed, 32));
+            sums[half] = _mm_add_epi64(sums[half], _mm_add_epi64(product, words));
+        }
+    }
+
+    for (uint half = 0; half < 2; half++) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&acc[half * 2]), sums[half]);
+    }
+#endif
+
+    for (; stripe < stripes; stripe++) {
+        for (size_t lane = 0; lane < LANES; lane++) {
+            u64 word;
+            std::memcpy(&word, &data[stripe * STRIPE_BYTES + lane * sizeof(u64)], sizeof(word));
+            u64 keyed = word ^ LANE_KEYS[lane];
+            acc[lane] += (keyed & 0xFFFFFFFF) * (keyed >> 32) + word;
+        }
+    }
+}
+
+auto hash_bytes(const u8* data, size_t size, u64 seed) -> u64 {
+    u64 h = seed ^ (size * MULTIPLIER);
+
+    size_t stripes = size / STRIPE_BYTES;
+    size_t i = stripes * STRIPE_BYTES;
+
+    if (stripes > 0) {
+        u64 acc[LANES] = { seed, seed, seed, seed };
+        accumulate_stripes(data, stripes, acc);
+        for (size_t lane = 0; lane < LANES; lane++) { h = mix(h, acc[lane]); }
+    }
+
+    /* Whatever is left over, eight bytes at a time and then one */
+    for (; i + sizeof(u64) <= size; i += sizeof(u64)) {
+        u64 word;
+        std::memcpy(&word, &data[i], sizeof(word));
+        h = mix(h, word);
+    }
+
+    for (; i < size; i++) { h = mix(h, data[i]); }
+
+    return h;
+}
+
+} // namespace hash
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "../definitions.h"
+
+#include <cstddef>
+
+namespace hash {
+
+/* Fast non-cryptographic hash for spotting changed data. Whole 32-byte
+ * stripes go through four independent lanes, vectorised where the target
+ * allows, so the result is the same whichever instruction set it was built
+ * for. */
+auto hash_bytes(const u8* data, size_t size, u64 seed = 0) -> u64;
+
+} // namespace hash
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "../definitions.h"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+/* Size of a cache line, used to keep data written by different threads
+ * from sharing one */
+const size_t CACHE_LINE_BYTES = 64;
+
+/* Bounded lock-free queue for exactly one producer thread and one consumer
+ * thread. Capacity must be a power of two; one slot is kept free to tell a
+ * full queue from an empty one. */
+template <typename T, size_t Capacity>
+class SpscQueue {
+    static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    /* Producer side: returns false, leaving the queue untouched, if full */
+    auto try_push(const T& item) -> bool {
+        size_t tail = write_index.load(std::memory_order_relaxed);
+        size_t next = (tail + 1) & (Capacity - 1);
+
+        if (next == cached_read_index) {
+            cached_read_index = read_index.load(std::memory_order_acquire);
+            if (next == cached_read_index) { return false; }
+        }
+
+        items[tail] = item;
+        write_index.store(next, std::memory_order_release);
+        return true;
+    }
+
+    /* Consumer side: returns false if there is nothing to take */
+    auto try_pop(T& item) -> bool {
+        size_t head = read_index.load(std::memory_order_relaxed);
+
+        if (head == cached_write_index) {
+            cached_write_index = write_index.load(std::memory_order_acquire);
+            if (head == cached_write_index) { return false; }
+        }
+
+        item = items[head];
+        read_index.store((head + 1) & (Capacity - 1), std::memory_order_release);
+        return true;
+    }
+
+    /* Approximate when called while the other side is active */
+    auto size() const -> size_t {
+        size_t head = read_index.load(std::memory_order_acquire);
+        size_t tail = write_index.load(std::memory_order_acquire);
+        return (tail - head) & (Capacity - 1);
+    }
+
+    auto capacity() const -> size_t { return Capacity - 1; }
+
+private:
+    /* Each side keeps its own index, and its last sight of the other's, on
+     * a cache line of its own */
+    alignas(CACHE_LINE_BYTES) std::atomic<size_t> write_index = {0};
+    size_t cached_read_index = 0;
+
+    alignas(CACHE_LINE_BYTES) std::atomic<size_t> read_index = {0};
+    size_t cached_write_index = 0;
+
+    alignas(CACHE_LINE_BYTES) std::array<T, Capacity> items = {};
+};
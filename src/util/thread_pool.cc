@@ -0,0 +1,66 @@
+#include "thread_pool.h"
+
+ThreadPool::ThreadPool(uint threads) {
+    for (uint n = 0; n < threads; n++) {
+        workers.emplace_back(&ThreadPool::worker_loop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    job_ready.notify_all();
+
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+auto ThreadPool::default_threads() -> uint {
+    uint hardware_threads = std::thread::hardware_concurrency();
+    return hardware_threads > 1 ? hardware_threads - 1 : 0;
+}
+
+void ThreadPool::run(uint count, const std::function<void(uint)>& _task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        task = &_task;
+        task_count = count;
+        next_task = 0;
+        workers_busy = size();
+        job_number++;
+    }
+    job_ready.notify_all();
+
+    work_on_job();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    job_done.wait(lock, [&]() { return workers_busy == 0; });
+    task = nullptr;
+}
+
+void ThreadPool::work_on_job() {
+    for (uint n = next_task++; n < task_count; n = next_task++) {
+        (*task)(n);
+    }
+}
+
+void ThreadPool::worker_loop() {
+    u64 last_job = 0;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            job_ready.wait(lock, [&]() { return stopping || job_number != last_job; });
+            if (stopping) { return; }
+            last_job = job_number;
+        }
+
+        work_on_job();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--workers_busy == 0) { job_done.notify_one(); }
+    }
+}
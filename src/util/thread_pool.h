@@ -0,0 +1,46 @@
+#pragma once
+
+#include "../definitions.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* A fixed set of worker threads for splitting one job into independent
+ * pieces. The calling thread works on the job too, so a pool of N threads
+ * runs N + 1 pieces at once. */
+class ThreadPool {
+public:
+    explicit ThreadPool(uint threads = default_threads());
+    ~ThreadPool();
+
+    /* Run task(0) to task(count - 1), in any order and on any thread, and
+     * return once all of them have finished */
+    void run(uint count, const std::function<void(uint)>& task);
+
+    auto size() const -> uint { return static_cast<uint>(workers.size()); }
+
+    /* One worker per hardware thread, besides the caller */
+    static auto default_threads() -> uint;
+
+private:
+    void worker_loop();
+    void work_on_job();
+
+    std::vector<std::thread> workers;
+
+    std::mutex mutex;
+    std::condition_variable job_ready;
+    std::condition_variable job_done;
+
+    const std::function<void(uint)>* task = nullptr;
+    uint task_count = 0;
+    std::atomic<uint> next_task = {0};
+
+    u64 job_number = 0;
+    uint workers_busy = 0;
+    bool stopping = false;
+};
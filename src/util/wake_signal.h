@@ -0,0 +1,53 @@
+#pragma once
+
+#include "../definitions.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+/* Lets one thread sleep until another has made some condition true. The
+ * condition lives in the caller's own atomics; the mutex is only taken when
+ * the waiter has actually gone to sleep, so notify() on a busy waiter costs
+ * one atomic operation. */
+class WakeSignal {
+public:
+    /* Sleeps until ready() returns true. Called from one thread at a time. */
+    template <typename Ready>
+    void wait_until(Ready&& ready) {
+        /* Waits are usually short, shorter than it takes to sleep and be
+         * woken, so keep looking for a while before going to sleep */
+        for (uint n = 0; n < SPIN_COUNT; n++) {
+            if (ready()) { return; }
+            std::this_thread::yield();
+        }
+
+        std::unique_lock<std::mutex> lock(mutex);
+
+        /* Announce the wait before the last look at the condition. Both
+         * sides touch waiting with a read-modify-write, so one comes first:
+         * either notify() sees this, or this sees what notify() followed. */
+        waiting.exchange(1, std::memory_order_acq_rel);
+
+        condition.wait(lock, ready);
+        waiting.store(0, std::memory_order_relaxed);
+    }
+
+    /* Call after making the condition true */
+    void notify() {
+        if (waiting.fetch_add(0, std::memory_order_acq_rel) == 0) { return; }
+
+        /* The waiter holds the lock until it is inside wait(), so taking it
+         * here means the notify can't land before it sleeps */
+        { std::lock_guard<std::mutex> lock(mutex); }
+        condition.notify_one();
+    }
+
+private:
+    static const uint SPIN_COUNT = 64;
+
+    std::atomic<uint> waiting = {0};
+    std::mutex mutex;
+    std::condition_variable condition;
+};
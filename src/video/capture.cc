@@ -0,0 +1,157 @@
+#include "capture.h"
+#include "video.h"
+
+#include "../util/log.h"
+
+#include <cstring>
+
+static auto clamp_byte(double value) -> u8 {
+    if (value < 0) { return 0; }
+    if (value > 255) { return 255; }
+    return static_cast<u8>(value + 0.5);
+}
+
+VideoCapture::VideoCapture(const std::string& path, CaptureFormat _format, const ShadeLut& lut, uint _every) :
+    format(_format),
+    every(_every == 0 ? 1 : _every)
+{
+    if (path == "-") {
+        file = stdout;
+        close_file = false;
+    } else {
+        file = std::fopen(path.c_str(), "wb");
+        close_file = true;
+        if (!file) { fatal_error("Could not open capture file: %s", path.c_str()); }
+    }
+
+    /* Shades only ever map to four colours, so convert them once here
+     * (BT.601, full range, as Y4M's C420jpeg expects) */
+    for (uint shade = 0; shade < 4; shade++) {
+        double r = lut[shade].r;
+        double g = lut[shade].g;
+        double b = lut[shade].b;
+
+        if (format == CaptureFormat::Y4m) {
+            shade_bytes[shade] = {{
+                clamp_byte(0.299 * r + 0.587 * g + 0.114 * b),
+                clamp_byte(128 - 0.168736 * r - 0.331264 * g + 0.5 * b),
+                clamp_byte(128 + 0.5 * r - 0.418688 * g - 0.081312 * b),
+            }};
+        } else {
+            shade_bytes[shade] = {{ lut[shade].r, lut[shade].g, lut[shade].b }};
+        }
+    }
+
+    output.resize(FRAME_PIXELS * 3);
+
+    for (u8 n = 0; n < POOL_FRAMES; n++) {
+        free_frames.try_push(n);
+    }
+
+    write_header();
+
+    writer = std::thread(&VideoCapture::writer_loop, this);
+}
+
+VideoCapture::~VideoCapture() {
+    finish();
+}
+
+void VideoCapture::finish() {
+    if (!writer.joinable()) { return; }
+
+    stopping = true;
+    frame_ready.notify();
+    writer.join();
+
+    if (close_file) {
+        std::fclose(file);
+    } else {
+        std::fflush(file);
+    }
+}
+
+void VideoCapture::add_frame(const FrameBuffer& frame) {
+    if (frames_seen++ % every != 0) { return; }
+
+    u8 n;
+    if (!free_frames.try_pop(n)) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    std::memcpy(pool[n].data(), frame.data(), FRAME_PIXELS);
+    full_frames.try_push(n);
+    frame_ready.notify();
+}
+
+void VideoCapture::writer_loop() {
+    while (true) {
+        /* Once asked to stop, finish off whatever was queued first. Seeing
+         * stopping set means every frame queued before it is in sight. */
+        u8 n;
+        bool popped = false;
+        frame_ready.wait_until([&] {
+            bool last = stopping;
+            popped = full_frames.try_pop(n);
+            return popped || last;
+        });
+
+        if (!popped) { return; }
+
+        write_frame(pool[n].data());
+        free_frames.try_push(n);
+    }
+}
+
+void VideoCapture::write_header() {
+    if (format != CaptureFormat::Y4m) { return; }
+
+    std::fprintf(file, "YUV4MPEG2 W%u H%u F%u:%llu Ip A1:1 C420jpeg XYSCSS=420JPEG\n",
+                 GAMEBOY_WIDTH, GAMEBOY_HEIGHT, CLOCK_RATE,
+                 static_cast<unsigned long long>(CLOCKS_PER_FRAME) * every);
+}
+
+void VideoCapture::write_frame(const u8* shades) {
+    if (format == CaptureFormat::Rgb24) {
+        for (uint i = 0; i < FRAME_PIXELS; i++) {
+            std::memcpy(&output[i * 3], shade_bytes[shades[i] & 0x3].data(), 3);
+        }
+        std::fwrite(output.data(), 1, FRAME_PIXELS * 3, file);
+    } else {
+        /* Full-resolution luma, then each chroma plane averaged over 2x2 blocks */
+        const uint chroma_width = GAMEBOY_WIDTH / 2;
+        const uint chroma_height = GAMEBOY_HEIGHT / 2;
+
+        u8* luma = output.data();
+        u8* cb = luma + FRAME_PIXELS;
+        u8* cr = cb + chroma_width * chroma_height;
+
+        for (uint i = 0; i < FRAME_PIXELS; i++) {
+            luma[i] = shade_bytes[shades[i] & 0x3][0];
+        }
+
+        for (uint y = 0; y < chroma_height; y++) {
+            for (uint x = 0; x < chroma_width; x++) {
+                const u8* top = &shades[(y * 2) * GAMEBOY_WIDTH + x * 2];
+                const u8* bottom = top + GAMEBOY_WIDTH;
+                const u8 block[4] = { top[0], top[1], bottom[0], bottom[1] };
+
+                uint sum_cb = 2;
+                uint sum_cr = 2;
+                for (u8 shade : block) {
+                    sum_cb += shade_bytes[shade & 0x3][1];
+                    sum_cr += shade_bytes[shade & 0x3][2];
+                }
+
+                cb[y * chroma_width + x] = static_cast<u8>(sum_cb / 4);
+                cr[y * chroma_width + x] = static_cast<u8>(sum_cr / 4);
+            }
+        }
+
+        std::fputs("FRAME\n", file);
+        std::fwrite(output.data(), 1, FRAME_PIXELS + 2 * chroma_width * chroma_height, file);
+    }
+
+    written.fetch_add(1, std::memory_order_relaxed);
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "framebuffer.h"
+
+#include "../definitions.h"
+#include "../util/spsc_queue.h"
+#include "../util/wake_signal.h"
+
+#include <array>
+#include <atomic>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum class CaptureFormat {
+    Y4m, /* YUV4MPEG2, 4:2:0 full-range, playable or encodable as is */
+    Rgb24, /* Headerless packed RGB: ffmpeg -f rawvideo -pix_fmt rgb24 -s 160x144 */
+};
+
+/* Records frames to a file, or to stdout given "-", for piping into an
+ * encoder. Frames are copied into a small pool of buffers and handed to a
+ * writer thread, which does the colour conversion and I/O. If the writer
+ * falls behind and the pool runs dry, frames are dropped and counted rather
+ * than holding up emulation. */
+class VideoCapture {
+public:
+    /* Records one frame in every `every` passed to add_frame */
+    VideoCapture(const std::string& path, CaptureFormat format, const ShadeLut& lut, uint every = 1);
+    ~VideoCapture();
+
+    /* Emulation thread: never blocks */
+    void add_frame(const FrameBuffer& frame);
+
+    /* Waits for queued frames to be written, then closes the output. Called
+     * by the destructor if not before. */
+    void finish();
+
+    auto frames_written() const -> u64 { return written.load(std::memory_order_relaxed); }
+    auto frames_dropped() const -> u64 { return dropped.load(std::memory_order_relaxed); }
+
+private:
+    static const uint POOL_FRAMES = 8;
+    static const uint FRAME_PIXELS = GAMEBOY_WIDTH * GAMEBOY_HEIGHT;
+
+    void writer_loop();
+    void write_header();
+    void write_frame(const u8* shades);
+
+    FILE* file;
+    bool close_file;
+    CaptureFormat format;
+    uint every;
+    u64 frames_seen = 0;
+
+    /* Output bytes for each shade: Y, Cb and Cr, or R, G and B */
+    std::array<std::array<u8, 3>, 4> shade_bytes;
+
+    std::array<std::array<u8, FRAME_PIXELS>, POOL_FRAMES> pool;
+    SpscQueue<u8, 16> free_frames; /* Writer thread to emulation thread */
+    SpscQueue<u8, 16> full_frames; /* Emulation thread to writer thread */
+    WakeSignal frame_ready; /* Wakes the writer for a full frame, or to stop */
+
+    std::vector<u8> output;
+
+    std::atomic<bool> stopping = {false};
+    std::atomic<u64> written = {0};
+    std::atomic<u64> dropped = {0};
+
+    std::thread writer;
+};
@@ -1,5 +0,0 @@
-#pragma once
-
-#include "../definitions.h"
-
-auto get_color(u8 pixel_value) -> GBColor;
\ No newline at end of file
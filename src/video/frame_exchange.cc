@@ -0,0 +1,34 @@
+#include "frame_exchange.h"
+
+FrameExchange::FrameExchange() :
+    buffers({{
+        FrameBuffer(GAMEBOY_WIDTH, GAMEBOY_HEIGHT),
+        FrameBuffer(GAMEBOY_WIDTH, GAMEBOY_HEIGHT),
+        FrameBuffer(GAMEBOY_WIDTH, GAMEBOY_HEIGHT),
+    }})
+{
+}
+
+void FrameExchange::publish(const FrameBuffer& frame) {
+    buffers[back] = frame;
+
+    u8 previous = shared.exchange(static_cast<u8>(back | FRESH), std::memory_order_acq_rel);
+    back = previous & INDEX_MASK;
+
+    published.fetch_add(1, std::memory_order_relaxed);
+    if (previous & FRESH) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+auto FrameExchange::take() -> const FrameBuffer* {
+    if (!(shared.load(std::memory_order_relaxed) & FRESH)) {
+        duplicated.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    u8 previous = shared.exchange(front, std::memory_order_acq_rel);
+    front = previous & INDEX_MASK;
+
+    return &buffers[front];
+}
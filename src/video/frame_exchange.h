@@ -0,0 +1,45 @@
+#pragma once
+
+#include "framebuffer.h"
+
+#include "../definitions.h"
+
+#include <array>
+#include <atomic>
+
+/* Triple-buffered handoff of finished frames from the emulation thread to a
+ * presenter thread. Each side owns one buffer, and the third is swapped
+ * between them with a single atomic exchange, so neither side ever waits.
+ * The presenter always gets the newest frame: frames published faster than
+ * they are taken are dropped, and takes with nothing new are duplicates. */
+class FrameExchange {
+public:
+    FrameExchange();
+
+    /* Emulation thread: copy a finished frame in and make it the newest */
+    void publish(const FrameBuffer& frame);
+
+    /* Presenter thread: the newest frame not taken yet, or nullptr if
+     * there is none, in which case the last frame taken is still valid */
+    auto take() -> const FrameBuffer*;
+
+    auto frames_published() const -> u64 { return published.load(std::memory_order_relaxed); }
+    auto frames_dropped() const -> u64 { return dropped.load(std::memory_order_relaxed); }
+    auto frames_duplicated() const -> u64 { return duplicated.load(std::memory_order_relaxed); }
+
+private:
+    /* The shared slot holds a buffer index, with this bit set while the
+     * buffer holds a frame the presenter has not seen */
+    static const u8 FRESH = 0x4;
+    static const u8 INDEX_MASK = 0x3;
+
+    std::array<FrameBuffer, 3> buffers;
+
+    u8 back = 0; /* Written by the emulation thread */
+    std::atomic<u8> shared = {1};
+    u8 front = 2; /* Read by the presenter thread */
+
+    std::atomic<u64> published = {0};
+    std::atomic<u64> dropped = {0};
+    std::atomic<u64> duplicated = {0};
+};
@@ -1,22 +1,52 @@
 #include "framebuffer.h"
 
+#include <algorithm>
+#include <cstring>
+
 FrameBuffer::FrameBuffer(uint _width, uint _height) :
     width(_width),
     height(_height),
-    buffer(width*height, Color::White)
+    buffer(width*height, static_cast<u8>(Color::White))
 {
 }
 
-void FrameBuffer::set_pixel(uint x, uint y, Color color) {
-    buffer[pixel_index(x, y)] = color;
+void FrameBuffer::to_rgb24(const ShadeLut& lut, u8* pixels, uint pitch) const {
+    for (uint y = 0; y < height; y++) {
+        const u8* shades = &buffer[pixel_index(0, y)];
+        u8* out = pixels + y * pitch;
+
+        for (uint x = 0; x < width; x++) {
+            const Rgb& color = lut[shades[x] & 0x3];
+            out[x * 3 + 0] = color.r;
+            out[x * 3 + 1] = color.g;
+            out[x * 3 + 2] = color.b;
+        }
+    }
 }
 
-auto FrameBuffer::get_pixel(uint x, uint y) const -> Color { return buffer.at(pixel_index(x, y)); }
+void FrameBuffer::to_rgba32(const ShadeLut& lut, u8* pixels, uint pitch) const {
+    /* Pre-pack each shade's four bytes so every pixel is a single store */
+    u32 packed[4];
+    for (uint i = 0; i < 4; i++) {
+        const u8 rgba[4] = { lut[i].r, lut[i].g, lut[i].b, 0xFF };
+        std::memcpy(&packed[i], rgba, sizeof(rgba));
+    }
 
-inline auto FrameBuffer::pixel_index(uint x, uint y) const -> uint { return (y * width) + x; }
+    for (uint y = 0; y < height; y++) {
+        const u8* shades = &buffer[pixel_index(0, y)];
+        u8* out = pixels + y * pitch;
 
-void FrameBuffer::reset() {
-    for (uint i = 0; i < width * height; i++) {
-        buffer[i] = Color::White;
+        for (uint x = 0; x < width; x++) {
+            std::memcpy(&out[x * 4], &packed[shades[x] & 0x3], sizeof(u32));
+        }
     }
-}
\ No newline at end of file
+}
+
+void FrameBuffer::set_frame_info(u64 hash, bool unchanged) {
+    frame_hash = hash;
+    frame_unchanged = unchanged;
+}
+
+void FrameBuffer::reset() {
+    std::fill(buffer.begin(), buffer.end(), static_cast<u8>(Color::White));
+}
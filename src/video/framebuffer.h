@@ -2,14 +2,44 @@
 
 #include "../definitions.h"
 
+#include <array>
 #include <vector>
 
+struct Rgb {
+    u8 r;
+    u8 g;
+    u8 b;
+};
+
+/* Output colour for each Color, indexed by its shade number */
+using ShadeLut = std::array<Rgb, 4>;
+
 class FrameBuffer {
 public:
     FrameBuffer(uint width, uint height);
 
-    void set_pixel(uint x, uint y, Color color);
-    auto get_pixel(uint x, uint y) const -> Color;
+    void set_pixel(uint x, uint y, Color color) { buffer[pixel_index(x, y)] = static_cast<u8>(color); }
+    auto get_pixel(uint x, uint y) const -> Color { return static_cast<Color>(buffer[pixel_index(x, y)]); }
+
+    /* Pixels are stored one byte each, holding the Color's shade number,
+     * row by row from the top left */
+    auto data() const -> const u8* { return buffer.data(); }
+    auto row(uint y) -> u8* { return &buffer[pixel_index(0, y)]; }
+
+    auto get_width() const -> uint { return width; }
+    auto get_height() const -> uint { return height; }
+
+    /* Convert the whole buffer into a caller-provided image, pitch bytes
+     * apart per row: packed R, G, B bytes, or R, G, B, A with A = 0xFF */
+    void to_rgb24(const ShadeLut& lut, u8* pixels, uint pitch) const;
+    void to_rgba32(const ShadeLut& lut, u8* pixels, uint pitch) const;
+
+    /* Hash of the pixels, and whether they match the previous frame. Set by
+     * Video before the frame is handed to the host, so consumers can skip
+     * converting, uploading or encoding a repeated frame */
+    auto hash() const -> u64 { return frame_hash; }
+    auto unchanged() const -> bool { return frame_unchanged; }
+    void set_frame_info(u64 hash, bool unchanged);
 
     void reset();
 
@@ -17,7 +47,10 @@ private:
     uint width;
     uint height;
 
-    auto pixel_index(uint x, uint y) const -> uint;
+    auto pixel_index(uint x, uint y) const -> uint { return (y * width) + x; }
+
+    std::vector<u8> buffer;
 
-    std::vector<Color> buffer;
-};
\ No newline at end of file
+    u64 frame_hash = 0;
+    bool frame_unchanged = false;
+};
@@ -0,0 +1,310 @@
+#include "pixel_fifo.h"
+
+#include "pixel_kernels.h"
+
+#include "../util/bitwise.h"
+#include "../util/hash.h"
+
+#include <cstring>
+
+using bitwise::check_bit;
+
+/* The first fetch of each line is thrown away, so nothing reaches the FIFO
+ * until the second has finished: together they give mode 3 its 172 dots
+ * for a line with no scrolling, window or sprites */
+static const uint DISCARDED_FETCH_DOTS = 6;
+static const uint FETCH_DOTS = 6;
+static const uint SPRITE_FETCH_DOTS = 6;
+
+PixelFifo::PixelFifo(const std::vector<u8>& _video_ram, const std::vector<u8>& _oam_ram) :
+    video_ram(_video_ram),
+    oam_ram(_oam_ram),
+    buffer(GAMEBOY_WIDTH, GAMEBOY_HEIGHT)
+{
+}
+
+void PixelFifo::begin_frame() {
+    window_triggered = false;
+    window_line = 0;
+}
+
+void PixelFifo::begin_line(u8 _current_line, const LineRegisters& registers, bool draw) {
+    current_line = _current_line;
+    drawing = draw;
+    line_dots = 0;
+    screen_x = 0;
+    discard_count = registers.scroll_x % TILE_WIDTH_PX;
+
+    fetch_step = 0;
+    fetch_tile_x = 0;
+    fetching_window = false;
+    bg_fifo_count = 0;
+    sprite_fifo = {};
+    fetching_sprite = false;
+
+    if (registers.window_y == current_line) { window_triggered = true; }
+    window_on_line = false;
+
+    /* OAM scan: the first 10 sprites in OAM that cover this line */
+    uint sprite_height = registers.sprite_size() ? TILE_HEIGHT_PX * 2 : TILE_HEIGHT_PX;
+    line_sprite_count = 0;
+
+    for (u8 n = 0; n < SPRITE_COUNT && line_sprite_count < MAX_SPRITES_PER_LINE; n++) {
+        uint sprite_y = oam_ram[n * SPRITE_BYTES];
+        if (current_line + 16u >= sprite_y && current_line + 16u < sprite_y + sprite_height) {
+            line_sprites[line_sprite_count] = n;
+            sprite_fetched[line_sprite_count] = false;
+            line_sprite_count++;
+        }
+    }
+}
+
+void PixelFifo::run(uint dots, const LineRegisters& registers) {
+    for (uint n = 0; n < dots && !line_finished(); n++) {
+        step(registers);
+    }
+}
+
+auto PixelFifo::min_dots_left() const -> uint {
+    /* Pixels still to be discarded aren't counted: the window starting at
+     * the left edge can cut them short */
+    uint dots = GAMEBOY_WIDTH - screen_x;
+
+    const uint first_push = DISCARDED_FETCH_DOTS + FETCH_DOTS;
+    if (line_dots < first_push) { dots += first_push - line_dots; }
+
+    return dots;
+}
+
+void PixelFifo::step(const LineRegisters& registers) {
+    line_dots++;
+    if (line_dots <= DISCARDED_FETCH_DOTS) { return; }
+
+    /* A sprite fetch first lets the background fetcher get as far as its
+     * last step, and the FIFO stands still throughout: 6 to 11 dots */
+    if (fetching_sprite) {
+        if (fetch_step < FETCH_DOTS - 1) {
+            fetcher_step(registers);
+        } else if (++sprite_dots == SPRITE_FETCH_DOTS) {
+            fetch_sprite(registers);
+            fetching_sprite = false;
+        }
+        return;
+    }
+
+    if (!fetching_window && window_triggered && registers.window_enabled()
+            && static_cast<int>(screen_x) + 7 >= registers.window_x) {
+        start_window(registers);
+    }
+
+    fetcher_step(registers);
+
+    if (bg_fifo_count == 0) { return; }
+
+    /* The dot that finds a sprite due is the first of its fetch */
+    if (discard_count == 0 && find_sprite_hit(registers)) {
+        fetching_sprite = true;
+        sprite_dots = 1;
+        return;
+    }
+
+    push_pixel(registers);
+}
+
+void PixelFifo::fetcher_step(const LineRegisters& registers) {
+    if (fetch_step == FETCH_DOTS) {
+        if (bg_fifo_count != 0) { return; }
+
+        pixel_kernels::decode_2bpp_line(fetch_low, fetch_high, bg_fifo.data());
+        bg_fifo_count = TILE_WIDTH_PX;
+        fetch_tile_x++;
+        fetch_step = 0;
+        return;
+    }
+
+    uint tile_line = fetching_window
+        ? window_line % TILE_HEIGHT_PX
+        : (current_line + registers.scroll_y) % TILE_HEIGHT_PX;
+
+    switch (fetch_step) {
+        case 1: {
+            bool high_map = fetching_window
+                ? registers.window_tile_map()
+                : registers.bg_tile_map_display();
+            Address tile_map = high_map ? TILE_MAP_ONE_ADDRESS : TILE_MAP_ZERO_ADDRESS;
+
+            uint map_x = fetching_window
+                ? fetch_tile_x
+                : registers.scroll_x / TILE_WIDTH_PX + fetch_tile_x;
+            uint map_y = fetching_window
+                ? window_line / TILE_HEIGHT_PX
+                : ((current_line + registers.scroll_y) % BG_MAP_SIZE) / TILE_HEIGHT_PX;
+
+            fetch_tile_id = video_ram[tile_map.value() - VRAM_START
+                + map_y * TILES_PER_LINE + map_x % TILES_PER_LINE];
+            break;
+        }
+        case 3:
+            fetch_low = video_ram[tile_data_address(fetch_tile_id, tile_line, registers)];
+            break;
+        case 5:
+            fetch_high = video_ram[tile_data_address(fetch_tile_id, tile_line, registers) + 1];
+            break;
+        default:
+            break;
+    }
+
+    fetch_step++;
+}
+
+/* Note: tileset two uses signed numbering to share half the tiles with tileset 1 */
+auto PixelFifo::tile_data_address(u8 tile_id, uint tile_line, const LineRegisters& registers) const -> uint {
+    uint tile_index = registers.bg_window_tile_data()
+        ? tile_id
+        : 256 + static_cast<s8>(tile_id);
+
+    return tile_index * TILE_BYTES + tile_line * 2;
+}
+
+void PixelFifo::start_window(const LineRegisters& registers) {
+    /* The background pixels still queued are dropped and the fetcher starts
+     * over on the window's first tile */
+    fetching_window = true;
+    window_on_line = true;
+    bg_fifo_count = 0;
+    fetch_step = 0;
+    fetch_tile_x = 0;
+
+    discard_count = registers.window_x < 7 ? 7u - registers.window_x : 0;
+}
+
+auto PixelFifo::find_sprite_hit(const LineRegisters& registers) -> bool {
+    if (!registers.sprites_enabled()) { return false; }
+
+    /* Sprite X is stored offset by 8, so a sprite is due once its left edge
+     * reaches the next pixel out. Those hanging off the left edge are all due
+     * at once, and go in the order their X would have reached them; ties go
+     * to the earlier sprite in OAM. */
+    bool found = false;
+    uint found_x = 0;
+
+    for (uint n = 0; n < line_sprite_count; n++) {
+        if (sprite_fetched[n]) { continue; }
+
+        uint sprite_x = oam_ram[line_sprites[n] * SPRITE_BYTES + 1];
+        if (sprite_x <= screen_x + 8 && (!found || sprite_x < found_x)) {
+            sprite_index = n;
+            found_x = sprite_x;
+            found = true;
+        }
+    }
+
+    return found;
+}
+
+void PixelFifo::fetch_sprite(const LineRegisters& registers) {
+    sprite_fetched[sprite_index] = true;
+
+    const u8* sprite = &oam_ram[line_sprites[sprite_index] * SPRITE_BYTES];
+    u8 sprite_attrs = sprite[3];
+
+    uint sprite_height = registers.sprite_size() ? TILE_HEIGHT_PX * 2 : TILE_HEIGHT_PX;
+
+    /* LCDC may have changed the sprite size since the OAM scan */
+    uint sprite_line = (current_line + 16u - sprite[0]) % sprite_height;
+    if (check_bit(sprite_attrs, 6)) { sprite_line = sprite_height - sprite_line - 1; }
+
+    /* The bottom half of an 8x16 sprite is the tile after the top half, so
+     * its lines follow straight on in VRAM */
+    u8 pattern_n = sprite[2];
+    if (sprite_height > TILE_HEIGHT_PX) { pattern_n &= 0xFE; }
+
+    uint address = pattern_n * TILE_BYTES + sprite_line * 2;
+
+    std::array<u8, TILE_WIDTH_PX> color_indices;
+    pixel_kernels::decode_2bpp_line(video_ram[address], video_ram[address + 1], color_indices.data());
+
+    bool flip_x = check_bit(sprite_attrs, 5);
+
+    /* Sprites already in the FIFO keep the pixels they cover: they were
+     * either further left or earlier in OAM */
+    for (uint x = 0; x < TILE_WIDTH_PX; x++) {
+        int pixel_x = sprite[1] - 8 + static_cast<int>(x);
+        if (pixel_x < static_cast<int>(screen_x)) { continue; }
+
+        u8 color_index = color_indices[flip_x ? TILE_WIDTH_PX - x - 1 : x];
+        SpritePixel& slot = sprite_fifo[static_cast<uint>(pixel_x) % TILE_WIDTH_PX];
+
+        if (color_index != 0 && slot.color_index == 0) {
+            slot = { color_index, check_bit(sprite_attrs, 4), check_bit(sprite_attrs, 7) };
+        }
+    }
+}
+
+void PixelFifo::push_pixel(const LineRegisters& registers) {
+    u8 bg_index = bg_fifo[TILE_WIDTH_PX - bg_fifo_count];
+    bg_fifo_count--;
+
+    if (discard_count > 0) {
+        discard_count--;
+        return;
+    }
+
+    SpritePixel& sprite = sprite_fifo[screen_x % TILE_WIDTH_PX];
+
+    /* With LCDC bit 0 clear the background and window are blank, and count
+     * as colour 0 for sprite priority */
+    u8 shade = static_cast<u8>(Color::White);
+    if (registers.bg_enabled()) {
+        shade = pixel_kernels::palette_shade(registers.bg_palette, bg_index);
+    } else {
+        bg_index = 0;
+    }
+
+    if (sprite.color_index != 0 && registers.sprites_enabled() && !(sprite.behind_bg && bg_index != 0)) {
+        u8 palette = sprite.use_palette_1
+            ? registers.sprite_palette_1
+            : registers.sprite_palette_0;
+        shade = pixel_kernels::palette_shade(palette, sprite.color_index);
+    }
+
+    sprite = {};
+
+    if (drawing) { buffer.row(current_line)[screen_x] = shade; }
+    screen_x++;
+
+    if (screen_x == GAMEBOY_WIDTH) { end_line(); }
+}
+
+void PixelFifo::end_line() {
+    if (window_on_line) { window_line++; }
+
+    if (!drawing) { return; }
+
+    u64 line_hash = hash::hash_bytes(buffer.row(current_line), GAMEBOY_WIDTH);
+    if (line_hash != line_hashes[current_line]) {
+        line_hashes[current_line] = line_hash;
+        frame_changed = true;
+    }
+}
+
+void PixelFifo::blank_line(u8 line) {
+    current_line = line;
+    drawing = true;
+    std::memset(buffer.row(line), static_cast<u8>(Color::White), GAMEBOY_WIDTH);
+
+    window_on_line = false;
+    end_line();
+}
+
+auto PixelFifo::finish_frame(bool rendered) -> const FrameBuffer& {
+    if (rendered) {
+        u64 frame_hash = hash::hash_bytes(reinterpret_cast<const u8*>(line_hashes.data()), sizeof(line_hashes));
+        buffer.set_frame_info(frame_hash, !frame_changed);
+        frame_changed = false;
+    } else {
+        buffer.set_frame_info(buffer.hash(), true);
+    }
+
+    return buffer;
+}
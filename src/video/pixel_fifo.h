@@ -0,0 +1,112 @@
+#pragma once
+
+#include "framebuffer.h"
+#include "renderer.h"
+#include "tile.h"
+
+#include "../definitions.h"
+
+#include <array>
+#include <vector>
+
+/* The accurate PPU tier: mode 3 run dot by dot the way the hardware does
+ * it, with a background fetcher feeding a pixel FIFO that shifts out one
+ * pixel a dot, and sprite fetches stalling it. Registers are sampled as the
+ * fetcher and the FIFO get to them, so writes part way along a line take
+ * effect from that pixel on, and mode 3 lasts as long as the line takes:
+ * longer for SCX fine scroll, the window and each sprite.
+ *
+ * Video runs it up to the present before every write that could affect
+ * drawing, passing the registers as they stood over that stretch. It reads
+ * VRAM and OAM straight from Video. */
+class PixelFifo {
+public:
+    PixelFifo(const std::vector<u8>& video_ram, const std::vector<u8>& oam_ram);
+
+    /* Resets the window's line counter and trigger */
+    void begin_frame();
+
+    /* Starts mode 3 for a line. Pixels are only stored when draw is set, so
+     * a skipped frame leaves the last one drawn intact. */
+    void begin_line(u8 current_line, const LineRegisters& registers, bool draw);
+
+    /* Runs for up to dots dots, stopping early only if the line finishes */
+    void run(uint dots, const LineRegisters& registers);
+
+    auto line_finished() const -> bool { return screen_x == GAMEBOY_WIDTH; }
+    auto dots_run() const -> uint { return line_dots; }
+
+    /* The fewest dots the line could still take, assuming no more stalls */
+    auto min_dots_left() const -> uint;
+
+    /* A line of the blank screen shown while the LCD is off */
+    void blank_line(u8 current_line);
+
+    auto finish_frame(bool rendered) -> const FrameBuffer&;
+
+private:
+    struct SpritePixel {
+        u8 color_index;
+        bool use_palette_1;
+        bool behind_bg;
+    };
+
+    void step(const LineRegisters& registers);
+    void fetcher_step(const LineRegisters& registers);
+    void start_window(const LineRegisters& registers);
+    auto find_sprite_hit(const LineRegisters& registers) -> bool;
+    void fetch_sprite(const LineRegisters& registers);
+    void push_pixel(const LineRegisters& registers);
+    void end_line();
+
+    auto tile_data_address(u8 tile_id, uint tile_line, const LineRegisters& registers) const -> uint;
+
+    const std::vector<u8>& video_ram;
+    const std::vector<u8>& oam_ram;
+
+    FrameBuffer buffer;
+
+    u8 current_line = 0;
+    bool drawing = true;
+    uint line_dots = 0;
+    uint screen_x = 0;
+
+    /* Pixels still to throw away before the first one shown: SCX's fine
+     * scroll, or the part of the window left of the screen when WX < 7 */
+    uint discard_count = 0;
+
+    /* Background fetcher: each fetch takes two dots for each of the tile
+     * number, the low byte and the high byte, then waits for the FIFO to
+     * empty before pushing its eight pixels */
+    uint fetch_step = 0;
+    uint fetch_tile_x = 0;
+    u8 fetch_tile_id = 0;
+    u8 fetch_low = 0;
+    u8 fetch_high = 0;
+    bool fetching_window = false;
+
+    std::array<u8, TILE_WIDTH_PX> bg_fifo = {};
+    uint bg_fifo_count = 0;
+
+    /* Indexed by screen x modulo 8, so slots line up with bg pixels */
+    std::array<SpritePixel, TILE_WIDTH_PX> sprite_fifo = {};
+
+    /* Sprites on this line in OAM order, and which have been fetched */
+    std::array<u8, MAX_SPRITES_PER_LINE> line_sprites = {};
+    std::array<bool, MAX_SPRITES_PER_LINE> sprite_fetched = {};
+    uint line_sprite_count = 0;
+
+    /* Set while the FIFO is stalled on a sprite fetch */
+    bool fetching_sprite = false;
+    uint sprite_index = 0;
+    uint sprite_dots = 0;
+
+    /* The window starts once LY has matched WY in a frame, and draws its own
+     * lines in turn, skipping lines it isn't shown on */
+    bool window_triggered = false;
+    bool window_on_line = false;
+    uint window_line = 0;
+
+    std::array<u64, GAMEBOY_HEIGHT> line_hashes = {};
+    bool frame_changed = true;
+};
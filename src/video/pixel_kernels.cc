@@ -0,0 +1,187 @@
+#include "pixel_kernels.h"
+
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace pixel_kernels {
+
+static void apply_palette_scalar(const u8* indices, uint count, u8 palette, u8* shades) {
+    const u8 lut[4] = {
+        palette_shade(palette, 0),
+        palette_shade(palette, 1),
+        palette_shade(palette, 2),
+        palette_shade(palette, 3),
+    };
+
+    for (uint i = 0; i < count; i++) {
+        shades[i] = lut[indices[i] & 0x3];
+    }
+}
+
+#if defined(__SSE2__)
+
+/* The decode kernels work on a low plane byte broadcast to bytes 0-7 of a
+ * register and the matching high plane byte broadcast to bytes 8-15. Each
+ * byte is tested against its pixel's bit, weighted 1 (low) or 2 (high), and
+ * the two halves are OR'd together to give 8 colour indices in bytes 0-7. */
+static inline auto pixel_masks() -> __m128i {
+    const char b7 = static_cast<char>(0x80);
+    return _mm_setr_epi8(b7, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01,
+                         b7, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01);
+}
+
+static inline auto plane_weights() -> __m128i {
+    return _mm_setr_epi8(1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2, 2);
+}
+
+static inline auto decode_planes(__m128i planes) -> __m128i {
+    __m128i masks = pixel_masks();
+    __m128i bit_set = _mm_cmpeq_epi8(_mm_and_si128(planes, masks), masks);
+    __m128i weighted = _mm_and_si128(bit_set, plane_weights());
+    return _mm_or_si128(weighted, _mm_srli_si128(weighted, 8));
+}
+
+/* Spread 4 bytes (low0, high0, low1, high1) so each byte fills 4 lanes */
+static inline auto spread_two_lines(const u8* tile_data) -> __m128i {
+    int packed;
+    std::memcpy(&packed, tile_data, sizeof(packed));
+
+    __m128i v = _mm_cvtsi32_si128(packed);
+    v = _mm_unpacklo_epi8(v, v);
+    return _mm_unpacklo_epi16(v, v);
+}
+
+#endif
+
+#if defined(__AVX2__)
+
+static inline auto decode_planes(__m256i planes) -> __m256i {
+    __m256i masks = _mm256_broadcastsi128_si256(pixel_masks());
+    __m256i weights = _mm256_broadcastsi128_si256(plane_weights());
+    __m256i bit_set = _mm256_cmpeq_epi8(_mm256_and_si256(planes, masks), masks);
+    __m256i weighted = _mm256_and_si256(bit_set, weights);
+    return _mm256_or_si256(weighted, _mm256_srli_si256(weighted, 8));
+}
+
+/* Four lines at a time: lines 0 and 1 in the low 128-bit lane, 2 and 3 in
+ * the high lane, so the per-lane unpacks mirror the SSE2 path */
+static void decode_four_lines(const u8* tile_data, u8* indices) {
+    __m128i bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(tile_data));
+    bytes = _mm_unpacklo_epi8(bytes, bytes);
+
+    __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(bytes), _mm_srli_si128(bytes, 8), 1);
+    v = _mm256_unpacklo_epi16(v, v);
+
+    __m256i even_lines = decode_planes(_mm256_unpacklo_epi32(v, v));
+    __m256i odd_lines = decode_planes(_mm256_unpackhi_epi32(v, v));
+
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(indices), _mm256_unpacklo_epi64(even_lines, odd_lines));
+}
+
+#endif
+
+void decode_2bpp_line(u8 byte1, u8 byte2, u8* indices) {
+#if defined(__SSE2__)
+    __m128i v = _mm_cvtsi32_si128(byte1 | (byte2 << 8));
+    v = _mm_unpacklo_epi8(v, v);
+    v = _mm_unpacklo_epi16(v, v);
+    v = _mm_unpacklo_epi32(v, v);
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(indices), decode_planes(v));
+#else
+    for (uint i = 0; i < 8; i++) {
+        indices[i] = static_cast<u8>((((byte2 >> (7 - i)) & 1) << 1) | ((byte1 >> (7 - i)) & 1));
+    }
+#endif
+}
+
+void decode_2bpp_lines(const u8* tile_data, uint line_count, u8* indices) {
+    uint line = 0;
+
+#if defined(__AVX2__)
+    for (; line + 4 <= line_count; line += 4) {
+        decode_four_lines(&tile_data[line * 2], &indices[line * 8]);
+    }
+#endif
+
+#if defined(__SSE2__)
+    for (; line + 2 <= line_count; line += 2) {
+        __m128i v = spread_two_lines(&tile_data[line * 2]);
+        __m128i line0 = decode_planes(_mm_unpacklo_epi32(v, v));
+        __m128i line1 = decode_planes(_mm_unpackhi_epi32(v, v));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&indices[line * 8]), _mm_unpacklo_epi64(line0, line1));
+    }
+#endif
+
+    for (; line < line_count; line++) {
+        decode_2bpp_line(tile_data[line * 2], tile_data[line * 2 + 1], &indices[line * 8]);
+    }
+}
+
+void apply_palette(const u8* indices, uint count, u8 palette, u8* shades) {
+    uint i = 0;
+
+#if defined(__SSSE3__)
+    /* The palette is a 4-entry byte table, so every index can be looked up
+     * at once with a byte shuffle */
+    __m128i lut = _mm_setr_epi8(
+        static_cast<char>(palette_shade(palette, 0)),
+        static_cast<char>(palette_shade(palette, 1)),
+        static_cast<char>(palette_shade(palette, 2)),
+        static_cast<char>(palette_shade(palette, 3)),
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+
+#if defined(__AVX2__)
+    __m256i lut_256 = _mm256_broadcastsi128_si256(lut);
+    for (; i + 32 <= count; i += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&indices[i]));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(&shades[i]), _mm256_shuffle_epi8(lut_256, v));
+    }
+#endif
+
+    for (; i + 16 <= count; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&indices[i]));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&shades[i]), _mm_shuffle_epi8(lut, v));
+    }
+#elif defined(__SSE2__)
+    /* Without a byte shuffle, select each shade by comparing against the
+     * four possible indices */
+    __m128i shade[4];
+    __m128i index[4];
+    for (u8 n = 0; n < 4; n++) {
+        shade[n] = _mm_set1_epi8(static_cast<char>(palette_shade(palette, n)));
+        index[n] = _mm_set1_epi8(static_cast<char>(n));
+    }
+
+    for (; i + 16 <= count; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&indices[i]));
+        __m128i result = _mm_and_si128(_mm_cmpeq_epi8(v, index[0]), shade[0]);
+        result = _mm_or_si128(result, _mm_and_si128(_mm_cmpeq_epi8(v, index[1]), shade[1]));
+        result = _mm_or_si128(result, _mm_and_si128(_mm_cmpeq_epi8(v, index[2]), shade[2]));
+        result = _mm_or_si128(result, _mm_and_si128(_mm_cmpeq_epi8(v, index[3]), shade[3]));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&shades[i]), result);
+    }
+#endif
+
+    apply_palette_scalar(&indices[i], count - i, palette, &shades[i]);
+}
+
+auto instruction_set() -> const char* {
+#if defined(__AVX2__)
+    return "AVX2";
+#elif defined(__SSSE3__)
+    return "SSSE3";
+#elif defined(__SSE2__)
+    return "SSE2";
+#else
+    return "scalar";
+#endif
+}
+
+} // namespace pixel_kernels
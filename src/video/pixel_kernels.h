@@ -0,0 +1,31 @@
+#pragma once
+
+#include "../definitions.h"
+
+/* Vectorised building blocks for turning tile data into screen pixels.
+ *
+ * The implementation is chosen at compile time from the target instruction
+ * set: AVX2, SSSE3 or SSE2, falling back to portable C++. Configure with
+ * -DGBEMU_NATIVE_ARCH=ON to build for everything the host CPU supports. */
+namespace pixel_kernels {
+
+/* Expand one line of 2bpp tile data into 8 colour indices (0-3), leftmost
+ * pixel first. byte1 holds the low bit of each pixel, byte2 the high bit. */
+void decode_2bpp_line(u8 byte1, u8 byte2, u8* indices);
+
+/* Decode line_count consecutive lines of tile data laid out as in VRAM
+ * (low byte, high byte, low byte, ...) into line_count * 8 colour indices */
+void decode_2bpp_lines(const u8* tile_data, uint line_count, u8* indices);
+
+/* Map count colour indices through a DMG palette register (BGP, OBP0 or
+ * OBP1) to shades, 0 (white) to 3 (black) */
+void apply_palette(const u8* indices, uint count, u8 palette, u8* shades);
+
+inline auto palette_shade(u8 palette, u8 index) -> u8 {
+    return static_cast<u8>((palette >> (index * 2)) & 0x3);
+}
+
+/* Name of the instruction set the kernels were built for */
+auto instruction_set() -> const char*;
+
+} // namespace pixel_kernels
@@ -0,0 +1,59 @@
+#include "ppu_compat.h"
+
+#ifdef GBEMU_ACCURATE_PPU
+static const PpuAccuracy DEFAULT_ACCURACY = PpuAccuracy::Accurate;
+#else
+static const PpuAccuracy DEFAULT_ACCURACY = PpuAccuracy::Fast;
+#endif
+
+struct CompatEntry {
+    const char* title; /* As in the cartridge header */
+    PpuAccuracy accuracy;
+};
+
+/* Games known to need one tier or the other. Pinning a game to Fast keeps
+ * it there even in builds that default to the accurate PPU; gbemu-test
+ * checks a game listed for Fast against the accurate PPU when given it. */
+static const CompatEntry COMPATIBILITY_LIST[] = {
+    /* Raster effects: palette and scroll writes during mode 3 */
+    { "PREHISTORIK MAN", PpuAccuracy::Accurate },
+
+    /* Registers only change between lines: identical frames either way */
+    { "POKEMON RED", PpuAccuracy::Fast },
+};
+
+namespace ppu_compat {
+
+auto listed_accuracy(const std::string& title) -> PpuAccuracy {
+    for (const CompatEntry& entry : COMPATIBILITY_LIST) {
+        if (title == entry.title) { return entry.accuracy; }
+    }
+
+    return PpuAccuracy::Auto;
+}
+
+auto choose_accuracy(PpuAccuracy requested, const std::string& title) -> PpuAccuracy {
+    if (requested != PpuAccuracy::Auto) { return requested; }
+
+    PpuAccuracy listed = listed_accuracy(title);
+    return listed != PpuAccuracy::Auto ? listed : DEFAULT_ACCURACY;
+}
+
+auto accuracy_from_name(const std::string& name, PpuAccuracy& accuracy) -> bool {
+    if (name == "auto") { accuracy = PpuAccuracy::Auto; return true; }
+    if (name == "fast") { accuracy = PpuAccuracy::Fast; return true; }
+    if (name == "accurate") { accuracy = PpuAccuracy::Accurate; return true; }
+    return false;
+}
+
+auto accuracy_name(PpuAccuracy accuracy) -> const char* {
+    switch (accuracy) {
+        case PpuAccuracy::Auto: return "auto";
+        case PpuAccuracy::Fast: return "fast";
+        case PpuAccuracy::Accurate: return "accurate";
+    }
+
+    return "auto";
+}
+
+} // namespace ppu_compat
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "../options.h"
+
+#include <string>
+
+/* Which PPU tier each game gets. The scanline renderer is much cheaper and
+ * draws nearly everything correctly, so games are only pinned to the pixel
+ * FIFO when they are known to change registers part way along a line. */
+namespace ppu_compat {
+
+/* The tier a game's title is listed with, or Auto if it isn't listed */
+auto listed_accuracy(const std::string& title) -> PpuAccuracy;
+
+/* Settles what to run: an explicit choice stands, and Auto takes the
+ * listed tier or else the build's default */
+auto choose_accuracy(PpuAccuracy requested, const std::string& title) -> PpuAccuracy;
+
+/* Parse a tier as given on the command line ("auto", "fast" or
+ * "accurate"), returning false if it isn't one */
+auto accuracy_from_name(const std::string& name, PpuAccuracy& accuracy) -> bool;
+auto accuracy_name(PpuAccuracy accuracy) -> const char*;
+
+} // namespace ppu_compat
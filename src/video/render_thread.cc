@@ -0,0 +1,86 @@
+#include "render_thread.h"
+
+RenderThread::RenderThread() :
+    outputs({{
+        FrameBuffer(GAMEBOY_WIDTH, GAMEBOY_HEIGHT),
+        FrameBuffer(GAMEBOY_WIDTH, GAMEBOY_HEIGHT),
+    }}),
+    thread(&RenderThread::run, this)
+{
+}
+
+RenderThread::~RenderThread() {
+    push({ RenderEventType::Stop, 0, 0, {} });
+    thread.join();
+}
+
+void RenderThread::write_vram(u16 address, u8 value) {
+    push({ RenderEventType::VramWrite, value, address, {} });
+}
+
+void RenderThread::write_oam(u16 address, u8 value) {
+    push({ RenderEventType::OamWrite, value, address, {} });
+}
+
+void RenderThread::render_line(u8 current_line, const LineRegisters& registers) {
+    push({ RenderEventType::Line, current_line, 0, registers });
+}
+
+auto RenderThread::finish_frame(bool rendered) -> const FrameBuffer& {
+    push({ RenderEventType::Frame, rendered, 0, {} });
+    frames_logged++;
+
+    /* The first frame has nothing before it, and gets a blank one */
+    uint previous = frames_logged - 1;
+    frame_done.wait_until([&] {
+        return frames_finished.load(std::memory_order_acquire) >= previous;
+    });
+
+    /* Frame n goes in outputs[n % 2], counting from 1, which leaves the
+     * blank buffer standing in for frame 0 */
+    return outputs[previous % 2];
+}
+
+void RenderThread::push(const RenderEvent& event) {
+    /* A full queue means the render thread is behind: wait for it rather
+     * than drop anything */
+    while (!events.try_push(event)) {
+        std::this_thread::yield();
+    }
+
+    events_ready.notify();
+}
+
+void RenderThread::run() {
+    RenderEvent event;
+
+    while (true) {
+        /* Sleep through the stretches with nothing logged, such as frames
+         * the game leaves unchanged or the emulator being paused */
+        if (!events.try_pop(event)) {
+            events_ready.wait_until([&] { return events.try_pop(event); });
+        }
+
+        switch (event.type) {
+            case RenderEventType::VramWrite:
+                renderer.write_vram(event.address, event.value);
+                break;
+            case RenderEventType::OamWrite:
+                renderer.write_oam(event.address, event.value);
+                break;
+            case RenderEventType::Line:
+                renderer.render_line(event.value, event.registers);
+                break;
+            case RenderEventType::Frame:
+                /* This buffer last held the frame before the one handed
+                 * over with this frame's end, so the host is done with it */
+                outputs[(frames_finished.load(std::memory_order_relaxed) + 1) % 2]
+                    = renderer.finish_frame(event.value != 0);
+                frames_finished.fetch_add(1, std::memory_order_release);
+                frame_done.notify();
+                break;
+            case RenderEventType::Stop:
+                return;
+        }
+    }
+}
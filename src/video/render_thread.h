@@ -0,0 +1,70 @@
+#pragma once
+
+#include "renderer.h"
+
+#include "../util/spsc_queue.h"
+#include "../util/wake_signal.h"
+
+#include <array>
+#include <atomic>
+#include <thread>
+
+enum class RenderEventType : u8 {
+    VramWrite,
+    OamWrite,
+    Line,
+    Frame,
+    Stop,
+};
+
+/* One entry in the log of everything the renderer needs to see, in the
+ * order the emulation thread produced it. Lines carry the registers they
+ * are drawn with, so register writes need no entries of their own. */
+struct RenderEvent {
+    RenderEventType type;
+    u8 value; /* Byte written, line number, or whether a frame was rendered */
+    u16 address;
+    LineRegisters registers;
+};
+
+/* Runs a Renderer on a thread of its own. The emulation thread logs VRAM and
+ * OAM writes and finished lines into a lock-free queue, and the render thread
+ * replays them in order, so the output matches drawing inline. Its output is
+ * double-buffered: finish_frame hands over the frame logged before the one it
+ * ends, which the render thread has had a whole frame to finish, so the CPU
+ * goes straight on to the next frame while the last is still being drawn.
+ * The frames are the ones drawing inline gives, each a frame later, after a
+ * blank first one. */
+class RenderThread {
+public:
+    RenderThread();
+    ~RenderThread();
+
+    void write_vram(u16 address, u8 value);
+    void write_oam(u16 address, u8 value);
+    void render_line(u8 current_line, const LineRegisters& registers);
+
+    /* Ends the frame being logged, and returns the one before it, waiting
+     * only if that is somehow not finished yet. The frame returned stays
+     * untouched until the next call. */
+    auto finish_frame(bool rendered) -> const FrameBuffer&;
+
+private:
+    void push(const RenderEvent& event);
+    void run();
+
+    Renderer renderer;
+
+    SpscQueue<RenderEvent, 1 << 14> events;
+    WakeSignal events_ready;
+
+    uint frames_logged = 0;
+    std::atomic<uint> frames_finished = {0};
+    WakeSignal frame_done;
+
+    /* Each finished frame is copied into the next of these in turn, so the
+     * render thread fills one while the host holds the other */
+    std::array<FrameBuffer, 2> outputs;
+
+    std::thread thread;
+};
@@ -0,0 +1,252 @@
+#include "renderer.h"
+
+#include "pixel_kernels.h"
+
+#include "../util/hash.h"
+
+#include <algorithm>
+#include <cstring>
+
+using bitwise::check_bit;
+
+Renderer::Renderer() :
+    buffer(GAMEBOY_WIDTH, GAMEBOY_HEIGHT)
+{
+}
+
+void Renderer::write_vram(u16 address, u8 value) {
+    /* Only the DMG's 8KB of VRAM is ever drawn from */
+    if (address >= vram.size()) { return; }
+
+    vram[address] = value;
+
+    /* Keep the decoded copy of the tile data in step with VRAM */
+    if (address < TILE_DATA_BYTES) {
+        uint line_start = address & ~1u;
+        tile_cache.update_line(line_start, vram[line_start], vram[line_start + 1]);
+    }
+}
+
+void Renderer::write_oam(u16 address, u8 value) {
+    oam[address] = value;
+    sprite_order_dirty = true;
+}
+
+void Renderer::render_line(u8 current_line, const LineRegisters& registers) {
+    u8* screen_line = buffer.row(current_line);
+
+    /* Columns left of first_x are not covered by the background or window
+     * and are left white, as is the whole line while the display is off */
+    uint first_x = GAMEBOY_WIDTH;
+
+    if (registers.display_enabled()) {
+        if (registers.bg_enabled()) {
+            draw_bg_line(current_line, registers);
+            first_x = 0;
+        }
+
+        if (registers.window_enabled()) {
+            first_x = std::min(first_x, draw_window_line(current_line, registers));
+        }
+    }
+
+    /* Uncovered columns count as background colour 0 for sprite priority */
+    std::memset(screen_line, static_cast<u8>(Color::White), first_x);
+    std::memset(line_color_indices.data(), 0, first_x);
+
+    /* The background and window share BGP, so the whole line goes through
+     * the palette in one pass, straight into the framebuffer */
+    if (first_x < GAMEBOY_WIDTH) {
+        pixel_kernels::apply_palette(&line_color_indices[first_x], GAMEBOY_WIDTH - first_x,
+                                     registers.bg_palette, &screen_line[first_x]);
+    }
+
+    if (registers.display_enabled() && registers.sprites_enabled()) {
+        draw_sprites_line(current_line, registers, screen_line);
+    }
+
+    /* Compare against the same line of the last frame as we go, so spotting
+     * a repeated frame costs one pass over each line while it is in cache */
+    u64 line_hash = hash::hash_bytes(screen_line, GAMEBOY_WIDTH);
+    if (line_hash != line_hashes[current_line]) {
+        line_hashes[current_line] = line_hash;
+        frame_changed = true;
+    }
+}
+
+auto Renderer::finish_frame(bool rendered) -> const FrameBuffer& {
+    if (rendered) {
+        u64 frame_hash = hash::hash_bytes(reinterpret_cast<const u8*>(line_hashes.data()), sizeof(line_hashes));
+        buffer.set_frame_info(frame_hash, !frame_changed);
+        frame_changed = false;
+    } else {
+        buffer.set_frame_info(buffer.hash(), true);
+    }
+
+    return buffer;
+}
+
+void Renderer::draw_bg_line(uint current_line, const LineRegisters& registers) {
+    bool use_tile_map_zero = !registers.bg_tile_map_display();
+
+    Address tile_map_address = use_tile_map_zero
+        ? TILE_MAP_ZERO_ADDRESS
+        : TILE_MAP_ONE_ADDRESS;
+
+    /* The background wraps around both edges of the 256x256 map */
+    uint bg_map_x = registers.scroll_x;
+    uint bg_map_y = (current_line + registers.scroll_y) % BG_MAP_SIZE;
+
+    draw_tile_map_line(tile_map_address, bg_map_x, bg_map_y, 0, registers);
+}
+
+auto Renderer::draw_window_line(uint current_line, const LineRegisters& registers) -> uint {
+    bool use_tile_map_zero = !registers.window_tile_map();
+
+    Address tile_map_address = use_tile_map_zero
+        ? TILE_MAP_ZERO_ADDRESS
+        : TILE_MAP_ONE_ADDRESS;
+
+    uint screen_y = current_line;
+    uint scrolled_y = screen_y - registers.window_y;
+
+    if (scrolled_y >= GAMEBOY_HEIGHT) { return GAMEBOY_WIDTH; }
+
+    /* The window is drawn from WX - 7 to the right edge of the screen. With
+     * WX < 7 the first few columns of the window are off the left edge */
+    int window_start_x = registers.window_x - 7;
+    if (window_start_x >= static_cast<int>(GAMEBOY_WIDTH)) { return GAMEBOY_WIDTH; }
+
+    uint screen_x = window_start_x < 0 ? 0 : static_cast<uint>(window_start_x);
+    uint scrolled_x = screen_x - window_start_x;
+
+    draw_tile_map_line(tile_map_address, scrolled_x, scrolled_y, screen_x, registers);
+
+    return screen_x;
+}
+
+/* Note: tileset two uses signed numbering to share half the tiles with tileset 1 */
+static auto bg_window_tile_index(u8 tile_id, const LineRegisters& registers) -> uint {
+    bool use_tile_set_zero = registers.bg_window_tile_data();
+
+    return use_tile_set_zero
+        ? tile_id
+        : 256 + static_cast<s8>(tile_id);
+}
+
+void Renderer::draw_tile_map_line(Address tile_map_address, uint map_x, uint map_y, uint screen_x,
+                                  const LineRegisters& registers) {
+    uint tile_y = map_y / TILE_HEIGHT_PX;
+    uint tile_pixel_y = map_y % TILE_HEIGHT_PX;
+
+    uint tile_map_row_offset = tile_map_address.value() - VRAM_START + tile_y * TILES_PER_LINE;
+
+    /* Walk the tile map one tile at a time, copying each tile's decoded line
+     * into the line's colour indices. Only the first tile can start part way
+     * through; the last may spill into the spare columns past the right edge */
+    uint tile_pixel_x = map_x % TILE_WIDTH_PX;
+
+    while (screen_x < GAMEBOY_WIDTH) {
+        uint tile_x = (map_x % BG_MAP_SIZE) / TILE_WIDTH_PX;
+
+        u8 tile_id = vram[tile_map_row_offset + tile_x];
+        const u8* pixel_line = tile_cache.get_line(bg_window_tile_index(tile_id, registers), tile_pixel_y);
+
+        uint pixel_count = TILE_WIDTH_PX - tile_pixel_x;
+        std::memcpy(&line_color_indices[screen_x], &pixel_line[tile_pixel_x], pixel_count);
+
+        screen_x += pixel_count;
+        map_x += pixel_count;
+        tile_pixel_x = 0;
+    }
+}
+
+void Renderer::sort_sprites() {
+    /* On the DMG the sprite further left wins where sprites overlap, with
+     * ties going to the one earlier in OAM */
+    for (u8 n = 0; n < SPRITE_COUNT; n++) {
+        sprite_order[n] = n;
+    }
+
+    std::stable_sort(sprite_order.begin(), sprite_order.end(), [&](u8 a, u8 b) {
+        return oam[a * SPRITE_BYTES + 1] < oam[b * SPRITE_BYTES + 1];
+    });
+
+    sprite_order_dirty = false;
+}
+
+void Renderer::draw_sprites_line(uint current_line, const LineRegisters& registers, u8* screen_line) {
+    if (sprite_order_dirty) { sort_sprites(); }
+
+    uint sprite_height = registers.sprite_size()
+        ? TILE_HEIGHT_PX * 2
+        : TILE_HEIGHT_PX;
+
+    /* The PPU takes the first 10 sprites in OAM that cover this line,
+     * whether or not they are horizontally on screen */
+    std::array<bool, SPRITE_COUNT> on_line = {};
+    uint sprites_found = 0;
+
+    for (uint n = 0; n < SPRITE_COUNT && sprites_found < MAX_SPRITES_PER_LINE; n++) {
+        /* Sprite Y is stored offset by 16, so a sprite at 0 is off the top */
+        uint sprite_y = oam[n * SPRITE_BYTES];
+        if (current_line + 16 >= sprite_y && current_line + 16 < sprite_y + sprite_height) {
+            on_line[n] = true;
+            sprites_found++;
+        }
+    }
+
+    if (sprites_found == 0) { return; }
+
+    /* Sprites are drawn in priority order, and the first opaque pixel drawn
+     * in a column hides any lower-priority sprite, even when it is itself
+     * hidden behind the background */
+    std::array<bool, GAMEBOY_WIDTH> column_taken = {};
+
+    for (u8 n : sprite_order) {
+        if (!on_line[n]) { continue; }
+
+        const u8* sprite = &oam[n * SPRITE_BYTES];
+        uint sprite_y = sprite[0];
+        int start_x = sprite[1] - 8;
+        u8 pattern_n = sprite[2];
+        u8 sprite_attrs = sprite[3];
+
+        /* Bits 0-3 are used only for CGB */
+        bool use_palette_1 = check_bit(sprite_attrs, 4);
+        bool flip_x = check_bit(sprite_attrs, 5);
+        bool flip_y = check_bit(sprite_attrs, 6);
+        bool obj_behind_bg = check_bit(sprite_attrs, 7);
+
+        u8 palette = use_palette_1
+            ? registers.sprite_palette_1
+            : registers.sprite_palette_0;
+
+        uint sprite_line = current_line + 16 - sprite_y;
+        if (flip_y) { sprite_line = sprite_height - sprite_line - 1; }
+
+        /* Sprites are always taken from the first tileset. In 8x16 mode the
+         * top half is pattern_n with bit 0 cleared, the bottom half the
+         * tile after it */
+        if (sprite_height > TILE_HEIGHT_PX) { pattern_n &= 0xFE; }
+
+        const u8* pixel_line = tile_cache.get_line(
+            pattern_n + sprite_line / TILE_HEIGHT_PX,
+            sprite_line % TILE_HEIGHT_PX);
+
+        for (uint x = 0; x < TILE_WIDTH_PX; x++) {
+            int screen_x = start_x + static_cast<int>(x);
+            if (screen_x < 0 || screen_x >= static_cast<int>(GAMEBOY_WIDTH)) { continue; }
+
+            u8 color_index = pixel_line[flip_x ? TILE_WIDTH_PX - x - 1 : x];
+
+            // Color 0 is transparent
+            if (color_index == 0 || column_taken[screen_x]) { continue; }
+            column_taken[screen_x] = true;
+
+            if (obj_behind_bg && line_color_indices[screen_x] != 0) { continue; }
+
+            screen_line[screen_x] = pixel_kernels::palette_shade(palette, color_index);
+        }
+    }
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "framebuffer.h"
+#include "tile.h"
+
+#include "../definitions.h"
+#include "../util/bitwise.h"
+
+#include <array>
+
+/* The LCD registers that affect how a line is drawn, as they stood when it
+ * was drawn */
+struct LineRegisters {
+    u8 lcd_control;
+    u8 scroll_y;
+    u8 scroll_x;
+    u8 window_y;
+    u8 window_x;
+    u8 bg_palette;
+    u8 sprite_palette_0;
+    u8 sprite_palette_1;
+
+    auto display_enabled() const -> bool { return bitwise::check_bit(lcd_control, 7); }
+    auto window_tile_map() const -> bool { return bitwise::check_bit(lcd_control, 6); }
+    auto window_enabled() const -> bool { return bitwise::check_bit(lcd_control, 5); }
+    auto bg_window_tile_data() const -> bool { return bitwise::check_bit(lcd_control, 4); }
+    auto bg_tile_map_display() const -> bool { return bitwise::check_bit(lcd_control, 3); }
+    auto sprite_size() const -> bool { return bitwise::check_bit(lcd_control, 2); }
+    auto sprites_enabled() const -> bool { return bitwise::check_bit(lcd_control, 1); }
+    auto bg_enabled() const -> bool { return bitwise::check_bit(lcd_control, 0); }
+};
+
+/* Draws scanlines into a framebuffer from its own copy of the VRAM and OAM
+ * it reads. Everything it needs arrives through write_vram, write_oam and
+ * the registers passed with each line, so it can be fed from a recording
+ * as easily as from Video directly. */
+class Renderer {
+public:
+    Renderer();
+
+    /* Addresses relative to the start of VRAM and OAM */
+    void write_vram(u16 address, u8 value);
+    void write_oam(u16 address, u8 value);
+
+    void render_line(u8 current_line, const LineRegisters& registers);
+
+    /* Finish off the frame, which was drawn if rendered is set and otherwise
+     * left as the last frame drawn, and return it */
+    auto finish_frame(bool rendered) -> const FrameBuffer&;
+
+private:
+    void draw_bg_line(uint current_line, const LineRegisters& registers);
+    auto draw_window_line(uint current_line, const LineRegisters& registers) -> uint;
+    void draw_tile_map_line(Address tile_map_address, uint map_x, uint map_y, uint screen_x,
+                            const LineRegisters& registers);
+    void draw_sprites_line(uint current_line, const LineRegisters& registers, u8* screen_line);
+    void sort_sprites();
+
+    FrameBuffer buffer;
+
+    /* Tile data and tile maps, raw and with the tiles decoded */
+    std::array<u8, TILE_DATA_BYTES + TILE_MAP_BYTES> vram = {};
+    TileCache tile_cache;
+
+    std::array<u8, SPRITE_COUNT * SPRITE_BYTES> oam = {};
+
+    /* Colour indices (before BGP) for the background and window of the line
+     * being drawn, with room for a tile to run past the right edge */
+    std::array<u8, GAMEBOY_WIDTH + TILE_WIDTH_PX> line_color_indices = {};
+
+    /* OAM indices from highest to lowest drawing priority, rebuilt after
+     * OAM changes */
+    std::array<u8, SPRITE_COUNT> sprite_order = {};
+    bool sprite_order_dirty = true;
+
+    /* Per-line pixel hashes of the last frame drawn */
+    std::array<u64, GAMEBOY_HEIGHT> line_hashes = {};
+    bool frame_changed = true;
+};
@@ -1,46 +1,17 @@
 #include "tile.h"
 
-#include "color.h"
-#include "../util/bitwise.h"
+#include "pixel_kernels.h"
 
-using bitwise::bit_value;
-
-Tile::Tile(Address& tile_address, MMU& mmu, uint size_multiplier) {
-    /* Set the whole framebuffer to be black */
-    for (uint x = 0; x < TILE_WIDTH_PX; x++) {
-        for (uint y = 0; y < TILE_HEIGHT_PX * size_multiplier; y++) {
-            buffer[pixel_index(x, y)] = GBColor::Color0;
-        }
-    }
-
-    for (uint tile_line = 0; tile_line < TILE_HEIGHT_PX * size_multiplier; tile_line++) {
-        /* 2 (bytes per line of pixels) * y (lines) */
-        uint index_into_tile = 2 * tile_line;
-        Address line_start = tile_address + index_into_tile;
-
-        u8 pixels_1 = mmu.read(line_start);
-        u8 pixels_2 = mmu.read(line_start + 1);
-
-        std::vector<u8> pixel_line = get_pixel_line(pixels_1, pixels_2);
-
-        for (uint x = 0; x < TILE_WIDTH_PX; x++) {
-            buffer[pixel_index(x, tile_line)] = get_color(pixel_line[x]);
-        }
-    }
+TileCache::TileCache() {
+    pixels.fill(0);
 }
 
-auto Tile::get_pixel(uint x, uint y) const -> GBColor { return buffer[pixel_index(x, y)]; }
-
-auto Tile::get_pixel_line(u8 byte1, u8 byte2) -> std::vector<u8> {
-    using bitwise::bit_value;
-
-    std::vector<u8> pixel_line;
-    for (u8 i = 0; i < 8; i++) {
-        u8 color_value = static_cast<u8>((bit_value(byte2, 7-i) << 1) | bit_value(byte1, 7-i));
-        pixel_line.push_back(color_value);
-    }
-
-    return pixel_line;
+void TileCache::update_line(uint tile_data_offset, u8 byte1, u8 byte2) {
+    /* Each line of a tile is two bytes, so the byte offset into tile data
+     * halved is also the line's index into the decoded pixels */
+    pixel_kernels::decode_2bpp_line(byte1, byte2, &pixels[(tile_data_offset / 2) * TILE_WIDTH_PX]);
 }
 
-inline auto Tile::pixel_index(uint x, uint y) -> uint { return (y * TILE_HEIGHT_PX) + x; }
\ No newline at end of file
+auto TileCache::get_line(uint tile_n, uint tile_line) const -> const u8* {
+    return &pixels[(tile_n * TILE_HEIGHT_PX + tile_line) * TILE_WIDTH_PX];
+}
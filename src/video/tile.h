@@ -2,7 +2,6 @@
 
 #include "../address.h"
 #include "../definitions.h"
-#include "../mmu.h"
 
 #include <array>
 
@@ -10,6 +9,8 @@ const uint TILES_PER_LINE = 32;
 const uint TILE_HEIGHT_PX = 8;
 const uint TILE_WIDTH_PX = 8;
 
+const u16 VRAM_START = 0x8000;
+
 const Address TILE_SET_ZERO_ADDRESS = 0x8000;
 const Address TILE_SET_ONE_ADDRESS = 0x8800;
 
@@ -20,16 +21,27 @@ const Address TILE_MAP_ONE_ADDRESS = 0x9C00;
 const uint TILE_BYTES = 2 * 8;
 
 const uint SPRITE_BYTES = 4;
+const uint SPRITE_COUNT = 40;
+const uint MAX_SPRITES_PER_LINE = 10;
+
+/* Tile data occupies 0x8000-0x97FF: 384 tiles of 16 bytes */
+const uint TILE_COUNT = 384;
+const uint TILE_DATA_BYTES = TILE_COUNT * TILE_BYTES;
+
+/* The two 32x32 tile maps follow, at 0x9800-0x9FFF */
+const uint TILE_MAP_BYTES = 2 * TILES_PER_LINE * TILES_PER_LINE;
 
-class Tile {
+/* Keeps every tile in VRAM decoded to one colour index (0-3) per pixel.
+ * Lines are re-decoded as their bytes are written, so drawing a tile never
+ * has to pick apart the two bit planes. */
+class TileCache {
 public:
-    Tile(Address& address, MMU& mmu, uint size_multiplier = 1);
+    TileCache();
 
-    auto get_pixel(uint x, uint y) const -> GBColor;
+    void update_line(uint tile_data_offset, u8 byte1, u8 byte2);
 
-private:
-    static auto pixel_index(uint x, uint y) -> uint;
-    static auto get_pixel_line(u8 byte1, u8 byte2) -> std::vector<u8>;
+    auto get_line(uint tile_n, uint tile_line) const -> const u8*;
 
-    std::array<GBColor, TILE_HEIGHT_PX * 2 * TILE_WIDTH_PX> buffer;
-};
\ No newline at end of file
+private:
+    std::array<u8, TILE_COUNT * TILE_HEIGHT_PX * TILE_WIDTH_PX> pixels;
+};
@@ -0,0 +1,401 @@
+#include "upscale.h"
+
+#include "../util/thread_pool.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace upscale {
+
+/* The filters read up to two pixels beyond each edge, which are copies of
+ * the edge pixels. Rows are padded further so whole vectors can be loaded
+ * anywhere along them. */
+static const uint BORDER = 2;
+static const uint ROW_PADDING = 16;
+static const uint PADDED_STRIDE = ROW_PADDING + GAMEBOY_WIDTH + ROW_PADDING;
+static const uint PADDED_HEIGHT = BORDER + GAMEBOY_HEIGHT + BORDER;
+
+/* Source rows per band of work handed to the pool */
+static const uint BAND_ROWS = 8;
+
+using PaddedFrame = std::array<u8, PADDED_STRIDE * PADDED_HEIGHT>;
+
+/* The filters are written once against these few operations on a vector of
+ * shades, or on a single shade without SSE2. Masks are all ones for true
+ * and all zeros for false in each lane. */
+#if defined(__SSE2__)
+
+using Shades = __m128i;
+static const uint LANES = 16;
+
+static inline auto load(const u8* p) -> Shades { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+static inline void store(u8* p, Shades v) { _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v); }
+
+static inline auto eq(Shades a, Shades b) -> Shades { return _mm_cmpeq_epi8(a, b); }
+static inline auto differ(Shades a, Shades b) -> Shades { return _mm_xor_si128(eq(a, b), _mm_set1_epi8(-1)); }
+static inline auto both(Shades a, Shades b) -> Shades { return _mm_and_si128(a, b); }
+static inline auto either(Shades a, Shades b) -> Shades { return _mm_or_si128(a, b); }
+static inline auto but_not(Shades a, Shades b) -> Shades { return _mm_andnot_si128(b, a); }
+static inline auto select(Shades mask, Shades a, Shades b) -> Shades {
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+/* Shades are 0-3, so sums of a few distances stay far below 128 */
+static inline auto distance(Shades a, Shades b) -> Shades {
+    return _mm_or_si128(_mm_subs_epu8(a, b), _mm_subs_epu8(b, a));
+}
+static inline auto add(Shades a, Shades b) -> Shades { return _mm_add_epi8(a, b); }
+static inline auto less(Shades a, Shades b) -> Shades { return _mm_cmplt_epi8(a, b); }
+static inline auto at_most(Shades a, Shades b) -> Shades { return _mm_cmpeq_epi8(_mm_min_epu8(a, b), a); }
+
+static inline void store_zip2(u8* out, Shades a, Shades b) {
+    store(out, _mm_unpacklo_epi8(a, b));
+    store(out + LANES, _mm_unpackhi_epi8(a, b));
+}
+
+static inline void store_zip3(u8* out, Shades a, Shades b, Shades c) {
+    alignas(16) u8 lanes[3][LANES];
+    store(lanes[0], a);
+    store(lanes[1], b);
+    store(lanes[2], c);
+
+    for (uint i = 0; i < LANES; i++) {
+        out[i * 3 + 0] = lanes[0][i];
+        out[i * 3 + 1] = lanes[1][i];
+        out[i * 3 + 2] = lanes[2][i];
+    }
+}
+
+#else
+
+using Shades = u8;
+static const uint LANES = 1;
+
+static inline auto load(const u8* p) -> Shades { return *p; }
+static inline void store(u8* p, Shades v) { *p = v; }
+
+static inline auto mask(bool b) -> Shades { return b ? 0xFF : 0x00; }
+static inline auto eq(Shades a, Shades b) -> Shades { return mask(a == b); }
+static inline auto differ(Shades a, Shades b) -> Shades { return mask(a != b); }
+static inline auto both(Shades a, Shades b) -> Shades { return a & b; }
+static inline auto either(Shades a, Shades b) -> Shades { return a | b; }
+static inline auto but_not(Shades a, Shades b) -> Shades { return static_cast<u8>(a & ~b); }
+static inline auto select(Shades m, Shades a, Shades b) -> Shades { return m ? a : b; }
+
+static inline auto distance(Shades a, Shades b) -> Shades { return static_cast<u8>(a > b ? a - b : b - a); }
+static inline auto add(Shades a, Shades b) -> Shades { return static_cast<u8>(a + b); }
+static inline auto less(Shades a, Shades b) -> Shades { return mask(a < b); }
+static inline auto at_most(Shades a, Shades b) -> Shades { return mask(a <= b); }
+
+static inline void store_zip2(u8* out, Shades a, Shades b) {
+    out[0] = a;
+    out[1] = b;
+}
+
+static inline void store_zip3(u8* out, Shades a, Shades b, Shades c) {
+    out[0] = a;
+    out[1] = b;
+    out[2] = c;
+}
+
+#endif
+
+/* Neighbourhood of the pixels starting at one point in the padded frame */
+class Window {
+public:
+    Window(const u8* _center) : center(_center) {}
+
+    auto at(int dx, int dy) const -> Shades {
+        return load(center + dy * static_cast<int>(PADDED_STRIDE) + dx);
+    }
+
+private:
+    const u8* center;
+};
+
+/* Scale2x (EPX): each pixel becomes four, and a corner takes the colour of
+ * the two neighbours it touches when they match and the others don't */
+static void scale2x_row(const u8* source, u8* const* out) {
+    for (uint x = 0; x < GAMEBOY_WIDTH; x += LANES) {
+        Window w(source + x);
+        Shades p = w.at(0, 0);
+        Shades a = w.at(0, -1);
+        Shades b = w.at(1, 0);
+        Shades c = w.at(-1, 0);
+        Shades d = w.at(0, 1);
+
+        Shades top_left = select(but_not(but_not(eq(c, a), eq(c, d)), eq(a, b)), a, p);
+        Shades top_right = select(but_not(but_not(eq(a, b), eq(a, c)), eq(b, d)), b, p);
+        Shades bottom_left = select(but_not(but_not(eq(d, c), eq(d, b)), eq(c, a)), c, p);
+        Shades bottom_right = select(but_not(but_not(eq(b, d), eq(b, a)), eq(d, c)), d, p);
+
+        store_zip2(&out[0][x * 2], top_left, top_right);
+        store_zip2(&out[1][x * 2], bottom_left, bottom_right);
+    }
+}
+
+/* Scale3x (AdvMAME3x), on the neighbourhood
+ *   A B C
+ *   D E F
+ *   G H I */
+static void scale3x_row(const u8* source, u8* const* out) {
+    for (uint x = 0; x < GAMEBOY_WIDTH; x += LANES) {
+        Window w(source + x);
+        Shades a = w.at(-1, -1), b = w.at(0, -1), c = w.at(1, -1);
+        Shades d = w.at(-1, 0), e = w.at(0, 0), f = w.at(1, 0);
+        Shades g = w.at(-1, 1), h = w.at(0, 1), i = w.at(1, 1);
+
+        /* Where each pair of edge neighbours forms a diagonal edge */
+        Shades db = but_not(but_not(eq(d, b), eq(b, f)), eq(d, h));
+        Shades bf = but_not(but_not(eq(b, f), eq(b, d)), eq(f, h));
+        Shades dh = but_not(but_not(eq(d, h), eq(d, b)), eq(h, f));
+        Shades hf = but_not(but_not(eq(h, f), eq(d, h)), eq(b, f));
+
+        Shades e0 = select(db, d, e);
+        Shades e1 = select(either(but_not(db, eq(e, c)), but_not(bf, eq(e, a))), b, e);
+        Shades e2 = select(bf, f, e);
+        Shades e3 = select(either(but_not(db, eq(e, g)), but_not(dh, eq(e, a))), d, e);
+        Shades e5 = select(either(but_not(bf, eq(e, i)), but_not(hf, eq(e, c))), f, e);
+        Shades e6 = select(dh, d, e);
+        Shades e7 = select(either(but_not(dh, eq(e, i)), but_not(hf, eq(e, g))), h, e);
+        Shades e8 = select(hf, f, e);
+
+        store_zip3(&out[0][x * 3], e0, e1, e2);
+        store_zip3(&out[1][x * 3], e3, e, e5);
+        store_zip3(&out[2][x * 3], e6, e7, e8);
+    }
+}
+
+/* One corner of an xBR pixel, named as for the bottom right corner of E:
+ *         A1 B1 C1
+ *      A0  A  B  C C4
+ *      D0  D  E  F F4
+ *      G0  G  H  I I4
+ *         G5 H5 I5
+ * The other corners pass the neighbourhood rotated to match. An edge runs
+ * through the corner when the pixels across it differ more than those
+ * along it, and the corner then takes the closer of F and H. */
+static inline auto xbr_corner(Shades e, Shades i, Shades h, Shades f, Shades g, Shades c,
+                              Shades d, Shades b, Shades f4, Shades i4, Shades h5, Shades i5) -> Shades {
+    Shades hf = distance(h, f);
+    Shades ei = distance(e, i);
+
+    /* Weighted differences along a H-F edge and across it */
+    Shades along = add(add(add(distance(e, c), distance(e, g)), add(distance(i, h5), distance(i, f4))),
+                       add(add(hf, hf), add(hf, hf)));
+    Shades across = add(add(add(distance(h, d), distance(h, i5)), add(distance(f, i4), distance(f, b))),
+                        add(add(ei, ei), add(ei, ei)));
+
+    /* Only corners of a pixel that differs from both F and H change, and
+     * only where the edge isn't part of a pattern better left alone */
+    Shades differs = both(differ(e, h), differ(e, f));
+
+    Shades shape = either(
+        either(both(differ(f, b), differ(h, d)),
+               both(eq(e, i), both(differ(f, i4), differ(h, i5)))),
+        either(eq(e, g), eq(e, c)));
+
+    Shades edge = both(both(differs, less(along, across)), shape);
+    Shades closer = select(at_most(distance(e, f), distance(e, h)), f, h);
+
+    return select(edge, closer, e);
+}
+
+static void xbr2x_row(const u8* source, u8* const* out) {
+    for (uint x = 0; x < GAMEBOY_WIDTH; x += LANES) {
+        Window w(source + x);
+        Shades a1 = w.at(-1, -2), b1 = w.at(0, -2), c1 = w.at(1, -2);
+        Shades a0 = w.at(-2, -1), a = w.at(-1, -1), b = w.at(0, -1), c = w.at(1, -1), c4 = w.at(2, -1);
+        Shades d0 = w.at(-2, 0), d = w.at(-1, 0), e = w.at(0, 0), f = w.at(1, 0), f4 = w.at(2, 0);
+        Shades g0 = w.at(-2, 1), g = w.at(-1, 1), h = w.at(0, 1), i = w.at(1, 1), i4 = w.at(2, 1);
+        Shades g5 = w.at(-1, 2), h5 = w.at(0, 2), i5 = w.at(1, 2);
+
+        Shades bottom_right = xbr_corner(e, i, h, f, g, c, d, b, f4, i4, h5, i5);
+        Shades top_right = xbr_corner(e, c, f, b, i, a, h, d, b1, c1, f4, c4);
+        Shades top_left = xbr_corner(e, a, b, d, c, g, f, h, d0, a0, b1, a1);
+        Shades bottom_left = xbr_corner(e, g, d, h, a, i, b, f, h5, g5, d0, g0);
+
+        store_zip2(&out[0][x * 2], top_left, top_right);
+        store_zip2(&out[1][x * 2], bottom_left, bottom_right);
+    }
+}
+
+static void nearest_row(const u8* source, u8* const* out) {
+    std::memcpy(out[0], source, GAMEBOY_WIDTH);
+}
+
+/* Write count shades as RGBA, each repeated across repeat pixels */
+static void expand_row(const u8* shades, uint count, uint repeat, const u32* packed, u8* out) {
+    uint i = 0;
+
+#if defined(__SSE2__)
+    /* Four pixels at a time: widen the shades to 32-bit lanes and pick each
+     * lane's colour by comparing against the four shade numbers */
+    __m128i colors[4];
+    __m128i numbers[4];
+    for (int n = 0; n < 4; n++) {
+        colors[n] = _mm_set1_epi32(static_cast<int>(packed[n]));
+        numbers[n] = _mm_set1_epi32(n);
+    }
+
+    const __m128i zero = _mm_setzero_si128();
+
+    for (; i + 4 <= count; i += 4) {
+        int four_shades;
+        std::memcpy(&four_shades, &shades[i], sizeof(four_shades));
+
+        __m128i v = _mm_cvtsi32_si128(four_shades);
+        v = _mm_unpacklo_epi16(_mm_unpacklo_epi8(v, zero), zero);
+
+        __m128i rgba = _mm_and_si128(_mm_cmpeq_epi32(v, numbers[0]), colors[0]);
+        for (int n = 1; n < 4; n++) {
+            rgba = _mm_or_si128(rgba, _mm_and_si128(_mm_cmpeq_epi32(v, numbers[n]), colors[n]));
+        }
+
+        u8* dest = &out[i * repeat * 4];
+
+        if (repeat == 1) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dest), rgba);
+        } else if (repeat == 2) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dest), _mm_unpacklo_epi32(rgba, rgba));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + 16), _mm_unpackhi_epi32(rgba, rgba));
+        } else {
+            /* Broadcast each lane and fill its run of pixels four at a time */
+            const __m128i lanes[4] = {
+                _mm_shuffle_epi32(rgba, 0x00),
+                _mm_shuffle_epi32(rgba, 0x55),
+                _mm_shuffle_epi32(rgba, 0xAA),
+                _mm_shuffle_epi32(rgba, 0xFF),
+            };
+
+            for (uint lane = 0; lane < 4; lane++) {
+                u8* run = dest + lane * repeat * 4;
+                uint pixel = 0;
+                for (; pixel + 4 <= repeat; pixel += 4) {
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(run + pixel * 4), lanes[lane]);
+                }
+                int color = _mm_cvtsi128_si32(lanes[lane]);
+                for (; pixel < repeat; pixel++) {
+                    std::memcpy(run + pixel * 4, &color, sizeof(color));
+                }
+            }
+        }
+    }
+#endif
+
+    for (; i < count; i++) {
+        for (uint pixel = 0; pixel < repeat; pixel++) {
+            std::memcpy(&out[(i * repeat + pixel) * 4], &packed[shades[i] & 0x3], sizeof(u32));
+        }
+    }
+}
+
+using RowFilter = void (*)(const u8* source, u8* const* out);
+
+static auto row_filter(UpscaleFilter filter) -> RowFilter {
+    switch (filter) {
+        case UpscaleFilter::Nearest: return nearest_row;
+        case UpscaleFilter::Scale2x: return scale2x_row;
+        case UpscaleFilter::Scale3x: return scale3x_row;
+        case UpscaleFilter::Xbr2x: return xbr2x_row;
+    }
+    return nearest_row;
+}
+
+auto native_scale(UpscaleFilter filter) -> uint {
+    switch (filter) {
+        case UpscaleFilter::Nearest: return 1;
+        case UpscaleFilter::Scale2x: return 2;
+        case UpscaleFilter::Scale3x: return 3;
+        case UpscaleFilter::Xbr2x: return 2;
+    }
+    return 1;
+}
+
+auto filter_from_name(const std::string& name, UpscaleFilter& filter) -> bool {
+    if (name == "nearest") { filter = UpscaleFilter::Nearest; return true; }
+    if (name == "scale2x") { filter = UpscaleFilter::Scale2x; return true; }
+    if (name == "scale3x") { filter = UpscaleFilter::Scale3x; return true; }
+    if (name == "xbr") { filter = UpscaleFilter::Xbr2x; return true; }
+    return false;
+}
+
+auto filter_name(UpscaleFilter filter) -> const char* {
+    switch (filter) {
+        case UpscaleFilter::Nearest: return "nearest";
+        case UpscaleFilter::Scale2x: return "scale2x";
+        case UpscaleFilter::Scale3x: return "scale3x";
+        case UpscaleFilter::Xbr2x: return "xbr";
+    }
+    return "unknown";
+}
+
+static void pad_frame(const FrameBuffer& frame, PaddedFrame& padded) {
+    for (uint y = 0; y < PADDED_HEIGHT; y++) {
+        /* Rows above and below the frame repeat its top and bottom rows */
+        uint source_y = y < BORDER ? 0 : y - BORDER;
+        if (source_y >= GAMEBOY_HEIGHT) { source_y = GAMEBOY_HEIGHT - 1; }
+
+        const u8* source = frame.data() + source_y * GAMEBOY_WIDTH;
+        u8* row = &padded[y * PADDED_STRIDE];
+
+        std::memset(row, source[0], ROW_PADDING);
+        std::memcpy(row + ROW_PADDING, source, GAMEBOY_WIDTH);
+        std::memset(row + ROW_PADDING + GAMEBOY_WIDTH, source[GAMEBOY_WIDTH - 1], ROW_PADDING);
+    }
+}
+
+void upscale(const FrameBuffer& frame, UpscaleFilter filter, uint factor, const ShadeLut& lut,
+             u8* pixels, uint pitch, ThreadPool* pool) {
+    uint native = native_scale(filter);
+    uint repeat = factor / native;
+    if (repeat == 0 || repeat * native != factor) { return; }
+
+    u32 packed[4];
+    for (uint i = 0; i < 4; i++) {
+        const u8 rgba[4] = { lut[i].r, lut[i].g, lut[i].b, 0xFF };
+        std::memcpy(&packed[i], rgba, sizeof(rgba));
+    }
+
+    PaddedFrame padded;
+    pad_frame(frame, padded);
+
+    RowFilter filter_row = row_filter(filter);
+    uint band_count = (GAMEBOY_HEIGHT + BAND_ROWS - 1) / BAND_ROWS;
+    uint out_row_bytes = GAMEBOY_WIDTH * factor * 4;
+
+    auto run_band = [&](uint band) {
+        /* Shades for one source row at the filter's native scale */
+        std::array<std::array<u8, GAMEBOY_WIDTH * 3>, 3> native_rows;
+        u8* native_out[3] = { native_rows[0].data(), native_rows[1].data(), native_rows[2].data() };
+
+        uint first_row = band * BAND_ROWS;
+        uint last_row = std::min(first_row + BAND_ROWS, GAMEBOY_HEIGHT);
+
+        for (uint y = first_row; y < last_row; y++) {
+            filter_row(&padded[(y + BORDER) * PADDED_STRIDE + ROW_PADDING], native_out);
+
+            for (uint n = 0; n < native; n++) {
+                u8* out = pixels + (y * factor + n * repeat) * pitch;
+                expand_row(native_out[n], GAMEBOY_WIDTH * native, repeat, packed, out);
+
+                for (uint copy = 1; copy < repeat; copy++) {
+                    std::memcpy(out + copy * pitch, out, out_row_bytes);
+                }
+            }
+        }
+    };
+
+    if (pool) {
+        pool->run(band_count, run_band);
+    } else {
+        for (uint band = 0; band < band_count; band++) { run_band(band); }
+    }
+}
+
+} // namespace upscale
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "framebuffer.h"
+
+#include "../definitions.h"
+
+#include <string>
+
+class ThreadPool;
+
+/* Pixel-art upscaling from a framebuffer straight to a 32-bit RGBA image.
+ *
+ * Each filter has a native scale: Nearest 1, Scale2x and Xbr2x 2, Scale3x 3.
+ * Any multiple of it may be asked for; the filter runs at its native scale
+ * and the result is then enlarged by whole pixels. Since DMG frames only
+ * ever hold four shades, the filters work on shade numbers, comparing them
+ * for equality (Scale2x/3x) or by their distance apart (Xbr2x), and colours
+ * come from the palette only at the end. */
+enum class UpscaleFilter {
+    Nearest,
+    Scale2x,
+    Scale3x,
+    Xbr2x, /* xBR level 1 corner rules, without colour blending */
+};
+
+namespace upscale {
+
+auto native_scale(UpscaleFilter filter) -> uint;
+
+/* Parse a filter name as given on the command line ("nearest", "scale2x",
+ * "scale3x" or "xbr"), returning false if it isn't one */
+auto filter_from_name(const std::string& name, UpscaleFilter& filter) -> bool;
+auto filter_name(UpscaleFilter filter) -> const char*;
+
+/* Upscale frame by factor, which must be a multiple of the filter's native
+ * scale, into pixels, pitch bytes apart per row. The image is split into
+ * bands of rows run on the pool when one is given. */
+void upscale(const FrameBuffer& frame, UpscaleFilter filter, uint factor, const ShadeLut& lut,
+             u8* pixels, uint pitch, ThreadPool* pool = nullptr);
+
+} // namespace upscale
@@ -1,20 +1,30 @@
 #include "video.h"
 
-#include "color.h"
+#include "ppu_compat.h"
+
 #include "../gameboy.h"
+#include "../cartridge/cartridge.h"
 #include "../cpu/cpu.h"
 
 #include "../util/bitwise.h"
 #include "../util/log.h"
 
-using bitwise::check_bit;
-
 Video::Video(Gameboy& inGb, Options& inOptions) :
     gb(inGb),
-    buffer(GAMEBOY_WIDTH, GAMEBOY_HEIGHT),
-    background_map(BG_MAP_SIZE, BG_MAP_SIZE)
+    background_map(BG_MAP_SIZE, BG_MAP_SIZE),
+    render_interval(inOptions.headless ? 0 : inOptions.render_interval)
 {
     video_ram = std::vector<u8>(0x4000);
+    oam_ram = std::vector<u8>(SPRITE_COUNT * SPRITE_BYTES);
+
+    PpuAccuracy accuracy = ppu_compat::choose_accuracy(inOptions.ppu_accuracy, gb.cartridge->get_info().title);
+    log_info("PPU:\t\t\t %s", ppu_compat::accuracy_name(accuracy));
+
+    if (accuracy == PpuAccuracy::Accurate) {
+        pixel_fifo = std::make_unique<PixelFifo>(video_ram, oam_ram);
+    } else if (inOptions.render_thread) {
+        render_thread = std::make_unique<RenderThread>();
+    }
 }
 
 u8 Video::read(const Address& address) {
@@ -22,380 +32,351 @@ u8 Video::read(const Address& address) {
 }
 
 void Video::write(const Address& address, u8 value) {
+    catch_up_pixels();
     video_ram.at(address.value()) = value;
-}
-
-void Video::tick(Cycles cycles) {
-    cycle_counter += cycles.cycles;
-
-    switch (current_mode) {
-        case VideoMode::ACCESS_OAM:
-            if (cycle_counter >= CLOCKS_PER_SCANLINE_OAM) {
-                cycle_counter = cycle_counter % CLOCKS_PER_SCANLINE_OAM;
-                lcd_status.set_bit_to(1, true);
-                lcd_status.set_bit_to(0, true);
-                current_mode = VideoMode::ACCESS_VRAM;
-            }
-            break;
-        case VideoMode::ACCESS_VRAM:
-            if (cycle_counter >= CLOCKS_PER_SCANLINE_VRAM) {
-                cycle_counter = cycle_counter % CLOCKS_PER_SCANLINE_VRAM;
-                current_mode = VideoMode::HBLANK;
 
-                bool hblank_interrupt = bitwise::check_bit(lcd_status.value(), 3);
+    if (pixel_fifo) { return; }
 
-                if (hblank_interrupt) {
-                    gb.cpu.interrupt_flag.set_bit_to(1, true);
-                }
+    /* Lines still waiting to be drawn must see VRAM as it was, but only
+     * if they read the part written */
+    if (pending_lines_read_vram(address.value())) { flush_lines(); }
 
-                bool ly_coincidence_interrupt = bitwise::check_bit(lcd_status.value(), 6);
-                bool ly_coincidence = ly_compare.value() == line.value();
-                if (ly_coincidence_interrupt && ly_coincidence) {
-                    gb.cpu.interrupt_flag.set_bit_to(1, true);
-                }
-                lcd_status.set_bit_to(2, ly_coincidence);
-
-                lcd_status.set_bit_to(1, false);
-                lcd_status.set_bit_to(0, false);
-            }
-            break;
-        case VideoMode::HBLANK:
-            if (cycle_counter >= CLOCKS_PER_HBLANK) {
-
-                write_scanline(line.value());
-                line.increment();
-
-                cycle_counter = cycle_counter % CLOCKS_PER_HBLANK;
-
-                /* Line 145 (index 144) is the first line of VBLANK */
-                if (line == 144) {
-                    current_mode = VideoMode::VBLANK;
-                    lcd_status.set_bit_to(1, false);
-                    lcd_status.set_bit_to(0, true);
-                    gb.cpu.interrupt_flag.set_bit_to(0, true);
-                } else {
-                    lcd_status.set_bit_to(1, true);
-                    lcd_status.set_bit_to(0, false);
-                    current_mode = VideoMode::ACCESS_OAM;
-                }
-            }
-            break;
-        case VideoMode::VBLANK:
-            if (cycle_counter >= CLOCKS_PER_SCANLINE) {
-                line.increment();
-
-                cycle_counter = cycle_counter % CLOCKS_PER_SCANLINE;
-
-                /* Line 155 (index 154) is the last line */
-                if (line == 154) {
-                    write_sprites();
-                    draw();
-                    buffer.reset();
-                    line.reset();
-                    current_mode = VideoMode::ACCESS_OAM;
-                    lcd_status.set_bit_to(1, true);
-                    lcd_status.set_bit_to(0, false);
-                };
-            }
-            break;
+    if (render_thread) {
+        render_thread->write_vram(address.value(), value);
+    } else {
+        renderer.write_vram(address.value(), value);
     }
 }
 
-auto Video::display_enabled() const -> bool { return check_bit(lcd_control.value(), 7); }
-auto Video::window_tile_map() const -> bool { return check_bit(lcd_control.value(), 6); }
-auto Video::window_enabled() const -> bool { return check_bit(lcd_control.value(), 5); }
-auto Video::bg_window_tile_data() const -> bool { return check_bit(lcd_control.value(), 4); }
-auto Video::bg_tile_map_display() const -> bool { return check_bit(lcd_control.value(), 3); }
-auto Video::sprite_size() const -> bool { return check_bit(lcd_control.value(), 2); }
-auto Video::sprites_enabled() const -> bool { return check_bit(lcd_control.value(), 1); }
-auto Video::bg_enabled() const -> bool { return check_bit(lcd_control.value(), 0); }
+u8 Video::read_oam(const Address& address) {
+    return oam_ram.at(address.value());
+}
 
-void Video::write_scanline(u8 current_line) {
-    if (!display_enabled()) { return; }
+void Video::write_oam(const Address& address, u8 value) {
+    catch_up_pixels();
+    oam_ram.at(address.value()) = value;
 
-    if (bg_enabled() && !debug_disable_background) {
-        draw_bg_line(current_line);
-    }
+    if (pixel_fifo) { return; }
+
+    if (pending_sprites) { flush_lines(); }
 
-    if (window_enabled() && !debug_disable_window) {
-        draw_window_line(current_line);
+    if (render_thread) {
+        render_thread->write_oam(address.value(), value);
+    } else {
+        renderer.write_oam(address.value(), value);
     }
 }
 
-void Video::write_sprites() {
-    if (!sprites_enabled() || debug_disable_sprites) { return; }
-
-    for (uint sprite_n = 0; sprite_n < 40; sprite_n++) {
-        draw_sprite(sprite_n);
+void Video::catch_up(u64 cycle) {
+    while (cycle >= next_event) {
+        if (lcd_control.check_bit(7)) {
+            next_event += next_mode();
+        } else {
+            draw_lcd_off_frame();
+            next_event += CLOCKS_PER_FRAME;
+        }
     }
 }
 
-void Video::draw_bg_line(uint current_line) {
-    /* Note: tileset two uses signed numbering to share half the tiles with tileset 1 */
-    bool use_tile_set_zero = bg_window_tile_data();
-    bool use_tile_map_zero = !bg_tile_map_display();
-
-    Palette palette = load_palette(bg_palette);
-
-    Address tile_set_address = use_tile_set_zero
-        ? TILE_SET_ZERO_ADDRESS
-        : TILE_SET_ONE_ADDRESS;
-
-    Address tile_map_address = use_tile_map_zero
-        ? TILE_MAP_ZERO_ADDRESS
-        : TILE_MAP_ONE_ADDRESS;
-
-    /* The pixel row we're drawing on the screen is constant since we're only
-     * drawing a single line */
-    uint screen_y = current_line;
+auto Video::next_mode() -> uint {
+    switch (current_mode) {
+        case VideoMode::ACCESS_OAM:
+            lcd_status.set_bit_to(1, true);
+            lcd_status.set_bit_to(0, true);
+            current_mode = VideoMode::ACCESS_VRAM;
+
+            /* Whether to render is settled here rather than when the last
+             * frame was drawn, so a request made once that frame has been
+             * handed over still counts for this one */
+            if (line == 0) { begin_frame(); }
+
+            if (pixel_fifo) {
+                vram_mode_start = next_event;
+                pixel_fifo->begin_line(line.value(), line_registers(), render_current_frame);
+                return pixel_fifo->min_dots_left();
+            }
+            return CLOCKS_PER_SCANLINE_VRAM;
+
+        case VideoMode::ACCESS_VRAM: {
+            uint hblank_clocks = CLOCKS_PER_HBLANK;
+
+            /* The accurate PPU's mode 3 lasts until the FIFO has pushed out
+             * the whole line. Each event is set for the soonest it could
+             * finish, so it ends exactly on one, and HBLANK takes the rest
+             * of the line's time. Mode 3 tops out at 172 dots plus 7 for fine
+             * scroll, 6 for the window and 11 for each of 10 sprites, which
+             * still leaves HBLANK at least one. */
+            if (pixel_fifo) {
+                pixel_fifo->run(static_cast<uint>(next_event - vram_mode_start) - pixel_fifo->dots_run(),
+                                line_registers());
+                if (!pixel_fifo->line_finished()) { return pixel_fifo->min_dots_left(); }
+
+                hblank_clocks = CLOCKS_PER_SCANLINE - CLOCKS_PER_SCANLINE_OAM - pixel_fifo->dots_run();
+            }
 
-    for (uint screen_x = 0; screen_x < GAMEBOY_WIDTH; screen_x++) {
-        /* Work out the position of the pixel in the framebuffer */
-        uint scrolled_x = screen_x + scroll_x.value();
-        uint scrolled_y = screen_y + scroll_y.value();
+            current_mode = VideoMode::HBLANK;
 
-        /* Work out the index of the pixel in the full background map */
-        uint bg_map_x = scrolled_x % BG_MAP_SIZE;
-        uint by_map_y = scrolled_y % BG_MAP_SIZE;
+            bool hblank_interrupt = bitwise::check_bit(lcd_status.value(), 3);
 
-        /* Work out which tile of the bg_map this pixel is in, and the index of that tile
-         * in the array of all tiles */
-        uint tile_x = bg_map_x / TILE_WIDTH_PX;
-        uint tile_y = by_map_y / TILE_HEIGHT_PX;
+            if (hblank_interrupt) {
+                gb.cpu.interrupt_flag.set_bit_to(1, true);
+            }
 
-        /* Work out which specific (x,y) inside that tile we're going to render */
-        uint tile_pixel_x = bg_map_x % TILE_WIDTH_PX;
-        uint tile_pixel_y = by_map_y % TILE_HEIGHT_PX;
+            bool ly_coincidence_interrupt = bitwise::check_bit(lcd_status.value(), 6);
+            bool ly_coincidence = ly_compare.value() == line.value();
+            if (ly_coincidence_interrupt && ly_coincidence) {
+                gb.cpu.interrupt_flag.set_bit_to(1, true);
+            }
+            lcd_status.set_bit_to(2, ly_coincidence);
 
-        /* Work out the address of the tile ID from the tile map */
-        uint tile_index = tile_y * TILES_PER_LINE + tile_x;
-        Address tile_id_address = tile_map_address + tile_index;
+            lcd_status.set_bit_to(1, false);
+            lcd_status.set_bit_to(0, false);
+            return hblank_clocks;
+        }
 
-        /* Grab the ID of the tile we'll get data from in the tile map */
-        u8 tile_id = gb.mmu.read(tile_id_address);
+        case VideoMode::HBLANK:
+            if (render_current_frame && !pixel_fifo) {
+                write_scanline(line.value());
+            }
+            line.increment();
 
-        /* Calculate the offset from the start of the tile data memory where
-         * the data for our tile lives */
-        uint tile_data_mem_offset = use_tile_set_zero
-            ? tile_id * TILE_BYTES
-            : (static_cast<s8>(tile_id) + 128) * TILE_BYTES;
+            /* Line 145 (index 144) is the first line of VBLANK */
+            if (line == 144) {
+                flush_lines();
+                current_mode = VideoMode::VBLANK;
+                lcd_status.set_bit_to(1, false);
+                lcd_status.set_bit_to(0, true);
+                gb.cpu.interrupt_flag.set_bit_to(0, true);
+                return CLOCKS_PER_SCANLINE;
+            }
 
-        /* Calculate the extra offset to the data for the line of pixels we
-         * are rendering from.
-         * 2 (bytes per line of pixels) * y (lines) */
-        uint tile_data_line_offset = tile_pixel_y * 2;
+            lcd_status.set_bit_to(1, true);
+            lcd_status.set_bit_to(0, false);
+            current_mode = VideoMode::ACCESS_OAM;
+            return CLOCKS_PER_SCANLINE_OAM;
 
-        Address tile_line_data_start_address = tile_set_address + tile_data_mem_offset + tile_data_line_offset;
+        case VideoMode::VBLANK:
+            line.increment();
 
-        /* FIXME: We fetch the full line of pixels for each pixel in the tile
-         * we render. This could be altered to work in a way that avoids re-fetching
-         * for a more performant renderer */
-        u8 pixels_1 = gb.mmu.read(tile_line_data_start_address);
-        u8 pixels_2 = gb.mmu.read(tile_line_data_start_address + 1);
+            /* Line 155 (index 154) is the last line */
+            if (line == 154) {
+                draw(render_current_frame);
+                line.reset();
+                current_mode = VideoMode::ACCESS_OAM;
+                lcd_status.set_bit_to(1, true);
+                lcd_status.set_bit_to(0, false);
+                return CLOCKS_PER_SCANLINE_OAM;
+            }
+            return CLOCKS_PER_SCANLINE;
+    }
 
-        GBColor pixel_color = get_pixel_from_line(pixels_1, pixels_2, tile_pixel_x);
-        Color screen_color = get_color_from_palette(pixel_color, palette);
+    return CLOCKS_PER_SCANLINE;
+}
 
-        buffer.set_pixel(screen_x, screen_y, screen_color);
+void Video::write_lcd_control(u8 value) {
+    bool was_on = lcd_control.check_bit(7);
+    lcd_control.set(value);
+    bool is_on = lcd_control.check_bit(7);
+
+    if (was_on == is_on) { return; }
+
+    flush_lines();
+
+    /* Either way the PPU restarts from the top of the screen, timed from
+     * the instruction that switched it */
+    line.reset();
+
+    if (is_on) {
+        current_mode = VideoMode::ACCESS_OAM;
+        lcd_status.set_bit_to(1, true);
+        lcd_status.set_bit_to(0, false);
+        next_event = gb.elapsed_cycles + CLOCKS_PER_SCANLINE_OAM;
+    } else {
+        /* Games switch off during VBlank, by which point the frame is
+         * complete, so pass it on before the screen goes blank */
+        if (current_mode == VideoMode::VBLANK) { draw(render_current_frame); }
+
+        current_mode = VideoMode::HBLANK;
+        lcd_status.set_bit_to(1, false);
+        lcd_status.set_bit_to(0, false);
+        next_event = gb.elapsed_cycles + CLOCKS_PER_FRAME;
+        blank_frame_drawn = false;
     }
 }
 
-void Video::draw_window_line(uint current_line) {
-    /* Note: tileset two uses signed numbering to share half the tiles with tileset 1 */
-    bool use_tile_set_zero = bg_window_tile_data();
-    bool use_tile_map_zero = !window_tile_map();
-
-    Palette palette = load_palette(bg_palette);
-
-    Address tile_set_address = use_tile_set_zero
-        ? TILE_SET_ZERO_ADDRESS
-        : TILE_SET_ONE_ADDRESS;
-
-    Address tile_map_address = use_tile_map_zero
-        ? TILE_MAP_ZERO_ADDRESS
-        : TILE_MAP_ONE_ADDRESS;
-
-    uint screen_y = current_line;
-    uint scrolled_y = screen_y - window_y.value();
-
-    if (scrolled_y >= GAMEBOY_HEIGHT) { return; }
-    // if (!is_on_screen_y(scrolled_y)) { return; }
-
-    for (uint screen_x = 0; screen_x < GAMEBOY_WIDTH; screen_x++) {
-        /* Work out the position of the pixel in the framebuffer */
-        uint scrolled_x = screen_x + window_x.value() - 7;
-
-        /* Work out which tile of the bg_map this pixel is in, and the index of that tile
-         * in the array of all tiles */
-        uint tile_x = scrolled_x / TILE_WIDTH_PX;
-        uint tile_y = scrolled_y / TILE_HEIGHT_PX;
-
-        /* Work out which specific (x,y) inside that tile we're going to render */
-        uint tile_pixel_x = scrolled_x % TILE_WIDTH_PX;
-        uint tile_pixel_y = scrolled_y % TILE_HEIGHT_PX;
-
-        /* Work out the address of the tile ID from the tile map */
-        uint tile_index = tile_y * TILES_PER_LINE + tile_x;
-        Address tile_id_address = tile_map_address + tile_index;
-
-        /* Grab the ID of the tile we'll get data from in the tile map */
-        u8 tile_id = gb.mmu.read(tile_id_address);
+void Video::draw_lcd_off_frame() {
+    /* The PPU is idle while the LCD is off, but the frontend still gets a
+     * frame every frame's worth of cycles to pace itself by. The screen is
+     * blank, so only the first of them needs drawing. */
+    if (!blank_frame_drawn) {
+        for (u8 n = 0; n < GAMEBOY_HEIGHT; n++) {
+            if (pixel_fifo) {
+                pixel_fifo->blank_line(n);
+            } else {
+                write_scanline(n);
+            }
+        }
+    }
 
-        /* Calculate the offset from the start of the tile data memory where
-         * the data for our tile lives */
-        uint tile_data_mem_offset = use_tile_set_zero
-            ? tile_id * TILE_BYTES
-            : (static_cast<s8>(tile_id) + 128) * TILE_BYTES;
+    draw(!blank_frame_drawn);
+    blank_frame_drawn = true;
 
-        /* Calculate the extra offset to the data for the line of pixels we
-         * are rendering from.
-         * 2 (bytes per line of pixels) * y (lines) */
-        uint tile_data_line_offset = tile_pixel_y * 2;
+    /* The blank frame handed over is as good as a rendered one */
+    frame_requested = false;
+}
 
-        Address tile_line_data_start_address = tile_set_address + tile_data_mem_offset + tile_data_line_offset;
+void Video::set_render_interval(uint frames) {
+    render_interval = frames;
+}
 
-        /* FIXME: We fetch the full line of pixels for each pixel in the tile
-         * we render. This could be altered to work in a way that avoids re-fetching
-         * for a more performant renderer */
-        u8 pixels_1 = gb.mmu.read(tile_line_data_start_address);
-        u8 pixels_2 = gb.mmu.read(tile_line_data_start_address + 1);
+void Video::request_frame() {
+    frame_requested = true;
+}
 
-        GBColor pixel_color = get_pixel_from_line(pixels_1, pixels_2, tile_pixel_x);
-        Color screen_color = get_color_from_palette(pixel_color, palette);
+void Video::catch_up_pixels() {
+    if (!pixel_fifo || current_mode != VideoMode::ACCESS_VRAM || !lcd_control.check_bit(7)) { return; }
 
-        buffer.set_pixel(screen_x, screen_y, screen_color);
+    u64 drawn_until = vram_mode_start + pixel_fifo->dots_run();
+    if (gb.elapsed_cycles > drawn_until) {
+        pixel_fifo->run(static_cast<uint>(gb.elapsed_cycles - drawn_until), line_registers());
     }
 }
 
-void Video::draw_sprite(const uint sprite_n) {
-    using bitwise::check_bit;
-
-    /* Each sprite is represented by 4 bytes, or 8 bytes in 8x16 mode */
-    Address offset_in_oam = sprite_n * SPRITE_BYTES;
-
-    Address oam_start = 0xFE00 + offset_in_oam.value();
-    u8 sprite_y = gb.mmu.read(oam_start);
-    u8 sprite_x = gb.mmu.read(oam_start + 1);
-
-    /* If the sprite would be drawn offscreen, don't draw it */
-    if (sprite_y == 0 || sprite_y >= 160) { return; }
-    if (sprite_x == 0 || sprite_x >= 168) { return; }
-
-    uint sprite_size_multiplier = sprite_size()
-        ? 2 : 1;
-
-    /* Sprites are always taken from the first tileset */
-    Address tile_set_location = TILE_SET_ZERO_ADDRESS;
+void Video::begin_frame() {
+    frames_since_render++;
+    if (pixel_fifo) { pixel_fifo->begin_frame(); }
 
-    u8 pattern_n = gb.mmu.read(oam_start + 2);
-    u8 sprite_attrs = gb.mmu.read(oam_start + 3);
+    render_current_frame = frame_requested
+        || (render_interval != 0 && frames_since_render >= render_interval);
 
-    /* Bits 0-3 are used only for CGB */
-    bool use_palette_1 = check_bit(sprite_attrs, 4);
-    bool flip_x = check_bit(sprite_attrs, 5);
-    bool flip_y = check_bit(sprite_attrs, 6);
-    bool obj_behind_bg = check_bit(sprite_attrs, 7);
-
-    Palette palette = use_palette_1
-        ? load_palette(sprite_palette_1)
-        : load_palette(sprite_palette_0);
-
-    uint tile_offset = pattern_n * TILE_BYTES;
-
-    Address pattern_address = tile_set_location + tile_offset;
-
-    Tile tile(pattern_address, gb.mmu, sprite_size_multiplier);
-    int start_y = sprite_y - 16;
-    int start_x = sprite_x - 8;
+    if (render_current_frame) {
+        frames_since_render = 0;
+        frame_requested = false;
+    }
+}
 
-    for (uint y = 0; y < TILE_HEIGHT_PX * sprite_size_multiplier; y++) {
-        for (uint x = 0; x < TILE_WIDTH_PX; x++) {
-            uint maybe_flipped_y = !flip_y ? y : (TILE_HEIGHT_PX * sprite_size_multiplier) - y - 1;
-            uint maybe_flipped_x = !flip_x ? x : TILE_WIDTH_PX - x - 1;
+auto Video::line_registers() const -> LineRegisters {
+    /* Layers turned off for debugging are drawn as if LCDC disabled them */
+    u8 control = lcd_control.value();
+    if (debug_disable_background) { control = bitwise::clear_bit(control, 0); }
+    if (debug_disable_sprites) { control = bitwise::clear_bit(control, 1); }
+    if (debug_disable_window) { control = bitwise::clear_bit(control, 5); }
+
+    return {
+        control,
+        scroll_y.value(),
+        scroll_x.value(),
+        window_y.value(),
+        window_x.value(),
+        bg_palette.value(),
+        sprite_palette_0.value(),
+        sprite_palette_1.value(),
+    };
+}
 
-            GBColor gb_color = tile.get_pixel(maybe_flipped_x, maybe_flipped_y);
+void Video::write_scanline(u8 current_line) {
+    /* The render thread already draws apart from the CPU, and sees VRAM and
+     * OAM writes in the order they come, so lines go straight to it */
+    if (render_thread) {
+        render_thread->render_line(current_line, line_registers());
+        return;
+    }
 
-            // Color 0 is transparent
-            if (gb_color == GBColor::Color0) { continue; }
+    /* Otherwise lines are only recorded here, and drawn together when
+     * VBlank starts. Register changes between lines are captured by the
+     * snapshots, so only a VRAM or OAM write to something the lines so far
+     * read forces them out early. */
+    if (pending_line_count == 0) { first_pending_line = current_line; }
 
-            int screen_x = start_x + x;
-            int screen_y = start_y + y;
+    LineRegisters registers = line_registers();
+    pending_lines[current_line] = registers;
+    pending_line_count++;
 
-            if (!is_on_screen(screen_x, screen_y)) { continue; }
+    note_line_reads(current_line, registers);
+}
 
-            auto existing_pixel = buffer.get_pixel(screen_x, screen_y);
+/* Mirrors what Renderer::render_line reads, a whole map row or every
+ * sprite at a time: close enough that a game updating the part of the
+ * screen not yet drawn, or tiles not on screen, does not flush */
+void Video::note_line_reads(u8 current_line, const LineRegisters& registers) {
+    if (!registers.display_enabled()) { return; }
 
-            // FIXME: We need to see if the color we're writing over is
-            // logically Color0, rather than looking at the color after
-            // the current palette has been applied
-            if (obj_behind_bg && existing_pixel != Color::White) { continue; }
+    if (registers.bg_enabled()) {
+        uint map_y = (current_line + registers.scroll_y) % BG_MAP_SIZE;
+        note_map_row_reads(registers.bg_tile_map_display(), map_y / TILE_HEIGHT_PX, registers);
+    }
 
-            Color screen_color = get_color_from_palette(gb_color, palette);
+    uint window_line = static_cast<uint>(current_line - registers.window_y);
+    if (registers.window_enabled() && window_line < GAMEBOY_HEIGHT && registers.window_x < GAMEBOY_WIDTH + 7) {
+        note_map_row_reads(registers.window_tile_map(), window_line / TILE_HEIGHT_PX, registers);
+    }
 
-            buffer.set_pixel(screen_x, screen_y, screen_color);
+    /* Sprites are looked up from OAM as it stands, which any OAM write
+     * flushes first, so their tiles only need noting once */
+    if (registers.sprites_enabled() && !pending_sprites) {
+        pending_sprites = true;
+        for (uint n = 0; n < SPRITE_COUNT; n++) {
+            /* Either half of a tall sprite, whatever the size is now */
+            u8 tile_id = oam_ram[n * SPRITE_BYTES + 2];
+            pending_tiles.set(tile_id & 0xFE);
+            pending_tiles.set(tile_id | 0x01);
         }
     }
 }
 
-auto Video::get_pixel_from_line(u8 byte1, u8 byte2, u8 pixel_index) -> GBColor {
-    using bitwise::bit_value;
+void Video::note_map_row_reads(bool map_one, uint row, const LineRegisters& registers) {
+    bool unsigned_tiles = registers.bg_window_tile_data();
 
-    u8 color_u8 = static_cast<u8>((bit_value(byte2, 7-pixel_index) << 1) | bit_value(byte1, 7-pixel_index));
-    return get_color(color_u8);
-}
-
-auto Video::is_on_screen_x(u8 x) -> bool { return x < GAMEBOY_WIDTH; }
-
-auto Video::is_on_screen_y(u8 y) -> bool { return y < GAMEBOY_HEIGHT; }
+    /* Keyed by tile numbering too, as LCDC can switch it between lines */
+    uint key = ((unsigned_tiles ? 2 : 0) + (map_one ? 1 : 0)) * TILES_PER_LINE + row;
+    if (pending_map_rows.test(key)) { return; }
+    pending_map_rows.set(key);
 
-auto Video::is_on_screen(u8 x, u8 y) -> bool { return is_on_screen_x(x) && is_on_screen_y(y); }
+    /* The map is as the lines will see it: a write to this row would flush */
+    Address map_address = map_one ? TILE_MAP_ONE_ADDRESS : TILE_MAP_ZERO_ADDRESS;
+    uint row_start = map_address.value() - VRAM_START + row * TILES_PER_LINE;
 
-auto Video::load_palette(ByteRegister& palette_register) -> Palette {
-    using bitwise::compose_bits;
-    using bitwise::bit_value;
-
-    /* TODO: Reduce duplication */
-    u8 color0 = compose_bits(bit_value(palette_register.value(), 1), bit_value(palette_register.value(), 0));
-    u8 color1 = compose_bits(bit_value(palette_register.value(), 3), bit_value(palette_register.value(), 2));
-    u8 color2 = compose_bits(bit_value(palette_register.value(), 5), bit_value(palette_register.value(), 4));
-    u8 color3 = compose_bits(bit_value(palette_register.value(), 7), bit_value(palette_register.value(), 6));
+    for (uint n = 0; n < TILES_PER_LINE; n++) {
+        u8 tile_id = video_ram[row_start + n];
+        pending_tiles.set(unsigned_tiles ? tile_id : 256 + static_cast<s8>(tile_id));
+    }
+}
 
-    Color real_color_0 = get_real_color(color0);
-    Color real_color_1 = get_real_color(color1);
-    Color real_color_2 = get_real_color(color2);
-    Color real_color_3 = get_real_color(color3);
+auto Video::pending_lines_read_vram(u16 address) const -> bool {
+    if (pending_line_count == 0) { return false; }
 
-    return { real_color_0, real_color_1, real_color_2, real_color_3 };
-}
+    if (address < TILE_DATA_BYTES) { return pending_tiles.test(address / TILE_BYTES); }
 
-auto Video::get_color_from_palette(GBColor color, const Palette& palette) -> Color {
-    switch (color) {
-        case GBColor::Color0: return palette.color0;
-        case GBColor::Color1: return palette.color1;
-        case GBColor::Color2: return palette.color2;
-        case GBColor::Color3: return palette.color3;
+    if (address < TILE_DATA_BYTES + TILE_MAP_BYTES) {
+        uint row = (address - TILE_DATA_BYTES) / TILES_PER_LINE;
+        return pending_map_rows.test(row) || pending_map_rows.test(row + 2 * TILES_PER_LINE);
     }
-}
 
+    /* The renderer draws nothing past the DMG's 8KB */
+    return false;
+}
 
-auto Video::get_real_color(u8 pixel_value) -> Color {
-    switch (pixel_value) {
-        case 0: return Color::White;
-        case 1: return Color::LightGray;
-        case 2: return Color::DarkGray;
-        case 3: return Color::Black;
-        default:
-            fatal_error("Invalid color value");
+void Video::flush_lines() {
+    for (uint n = first_pending_line; n < first_pending_line + pending_line_count; n++) {
+        renderer.render_line(static_cast<u8>(n), pending_lines[n]);
     }
-}
 
-void Video::register_vblank_callback(const vblank_callback_t& _vblank_callback) {
-    vblank_callback = _vblank_callback;
+    pending_line_count = 0;
+    pending_tiles.reset();
+    pending_map_rows.reset();
+    pending_sprites = false;
 }
 
-void Video::draw() {
+void Video::draw(bool rendered) {
     static int frame_count = 0;
     frame_count++;
     fprintf(stderr, "[DRAW] frame=%d lcdc=0x%02X\n", frame_count, lcd_control.value());
-    vblank_callback(buffer);
+
+    flush_lines();
+
+    finished_frame = pixel_fifo
+        ? &pixel_fifo->finish_frame(rendered)
+        : render_thread
+        ? &render_thread->finish_frame(rendered)
+        : &renderer.finish_frame(rendered);
 }
\ No newline at end of file
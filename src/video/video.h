@@ -1,6 +1,9 @@
 #pragma once
 
 #include "framebuffer.h"
+#include "pixel_fifo.h"
+#include "renderer.h"
+#include "render_thread.h"
 #include "tile.h"
 
 #include "../mmu.h"
@@ -8,14 +11,13 @@
 #include "../definitions.h"
 #include "../options.h"
 
+#include <array>
+#include <bitset>
 #include <vector>
 #include <memory>
-#include <functional>
 
 class Gameboy;
 
-using vblank_callback_t = std::function<void(const FrameBuffer&)>;
-
 enum class VideoMode {
     ACCESS_OAM,
     ACCESS_VRAM,
@@ -28,17 +30,59 @@ struct TileInfo {
     std::vector<u8> pixels;
 };
 
+const uint CLOCKS_PER_HBLANK = 204; /* Mode 0 */
+const uint CLOCKS_PER_SCANLINE_OAM = 80; /* Mode 2 */
+const uint CLOCKS_PER_SCANLINE_VRAM = 172; /* Mode 3 */
+const uint CLOCKS_PER_SCANLINE =
+    (CLOCKS_PER_SCANLINE_OAM + CLOCKS_PER_SCANLINE_VRAM + CLOCKS_PER_HBLANK);
+
+const uint CLOCKS_PER_VBLANK = 4560; /* Mode 1 */
+const uint SCANLINES_PER_FRAME = 144;
+const uint CLOCKS_PER_FRAME = (CLOCKS_PER_SCANLINE * SCANLINES_PER_FRAME) + CLOCKS_PER_VBLANK;
+
 class Video {
 public:
     Video(Gameboy& inGb, Options& inOptions);
 
-    void tick(Cycles cycles);
-    void register_vblank_callback(const vblank_callback_t& _vblank_callback);
+    /* The PPU only does work at mode changes. next_event_cycle() is when
+     * the next one is due, and catch_up() runs every change up to the given
+     * cycle of the master clock; between changes LY and STAT stand still, so
+     * nothing else needs to call into Video. */
+    auto next_event_cycle() const -> u64 { return next_event; }
+    void catch_up(u64 cycle);
+
+    /* The frame finished at the last VBLANK, once: null until another is.
+     * One can also be finished by an LCDC write switching the LCD off, so
+     * the CPU must stop to collect it as soon as frame_finished() is set. */
+    auto frame_finished() const -> bool { return finished_frame != nullptr; }
+    auto take_finished_frame() -> const FrameBuffer* {
+        const FrameBuffer* frame = finished_frame;
+        finished_frame = nullptr;
+        return frame;
+    }
+
+    /* Skipped frames keep exact mode and interrupt timing but draw nothing:
+     * the finished frame is the last rendered one, marked unchanged.
+     * An interval of 0 renders only frames asked for with request_frame(),
+     * which asks for the next frame handed over: made as soon as one has
+     * been, it counts for the frame straight after. */
+    void set_render_interval(uint frames);
+    void request_frame();
 
     u8 read(const Address& address);
     void write(const Address& address, u8 byte);
 
-    ByteRegister lcd_control;
+    u8 read_oam(const Address& address);
+    void write_oam(const Address& address, u8 byte);
+
+    /* Switching the LCD off stops the PPU at line 0 until it comes back on */
+    void write_lcd_control(u8 value);
+
+    /* With the accurate PPU, draws mode 3 up to the current cycle, so a
+     * register write that follows lands on the right pixel */
+    void catch_up_pixels();
+
+    ByteRegister lcd_control; /* Written through write_lcd_control */
     ByteRegister lcd_status;
 
     ByteRegister scroll_y;
@@ -65,52 +109,60 @@ public:
     bool debug_disable_window = false;
 
 private:
+    void begin_frame();
+    auto next_mode() -> uint;
     void write_scanline(u8 current_line);
-    void write_sprites();
-    void draw();
-    void draw_bg_line(uint current_line);
-    void draw_window_line(uint current_line);
-    void draw_sprite(uint sprite_n);
-    static auto get_pixel_from_line(u8 byte1, u8 byte2, u8 pixel_index) -> GBColor;
-
-    static auto is_on_screen(u8 x, u8 y) -> bool;
-    static auto is_on_screen_x(u8 x) -> bool;
-    static auto is_on_screen_y(u8 y) -> bool;
-
-    auto display_enabled() const -> bool;
-    auto window_tile_map() const -> bool;
-    auto window_enabled() const -> bool;
-    auto bg_window_tile_data() const -> bool;
-    auto bg_tile_map_display() const -> bool;
-    auto sprite_size() const -> bool;
-    auto sprites_enabled() const -> bool;
-    auto bg_enabled() const -> bool;
+    void note_line_reads(u8 current_line, const LineRegisters& registers);
+    void note_map_row_reads(bool map_one, uint row, const LineRegisters& registers);
+    auto pending_lines_read_vram(u16 address) const -> bool;
+    void flush_lines();
+    void draw_lcd_off_frame();
+    void draw(bool rendered);
 
-    auto get_tile_info(Address tile_set_location, u8 tile_id, u8 tile_line) const -> TileInfo;
+    auto line_registers() const -> LineRegisters;
 
-    static auto get_real_color(u8 pixel_value) -> Color;
-    static auto load_palette(ByteRegister& palette_register) -> Palette;
-    static auto get_color_from_palette(GBColor color, const Palette& palette) -> Color;
+    auto get_tile_info(Address tile_set_location, u8 tile_id, u8 tile_line) const -> TileInfo;
 
     Gameboy& gb;
 
-    FrameBuffer buffer;
     FrameBuffer background_map;
 
     std::vector<u8> video_ram;
-
-    VideoMode current_mode = VideoMode::ACCESS_OAM;
-    uint cycle_counter = 0;
-
-    vblank_callback_t vblank_callback;
+    std::vector<u8> oam_ram;
+
+    /* Lines are drawn by the renderer here, or by one on a render thread
+     * when that is enabled */
+    Renderer renderer;
+    std::unique_ptr<RenderThread> render_thread;
+
+    /* Set when running the accurate PPU, which draws each line itself as
+     * mode 3 goes along, in place of the renderer */
+    std::unique_ptr<PixelFifo> pixel_fifo;
+    u64 vram_mode_start = 0;
+
+    /* Register snapshots for lines finished but not yet drawn, which are
+     * always a run of consecutive lines. Only kept without a render thread,
+     * which is handed each line as it finishes. */
+    std::array<LineRegisters, GAMEBOY_HEIGHT> pending_lines = {};
+    uint first_pending_line = 0;
+    uint pending_line_count = 0;
+
+    /* What the pending lines read, so only writes to it flush them: tiles
+     * by number from 0x8000, map rows by tile numbering, map and row, and
+     * whether any line draws sprites and so reads OAM */
+    std::bitset<TILE_COUNT> pending_tiles;
+    std::bitset<4 * TILES_PER_LINE> pending_map_rows;
+    bool pending_sprites = false;
+
+    uint render_interval = 1;
+    uint frames_since_render = 0;
+    bool frame_requested = false;
+    bool render_current_frame = true;
+
+    /* The LCD starts off, until LCDC turns it on */
+    VideoMode current_mode = VideoMode::HBLANK;
+    u64 next_event = CLOCKS_PER_FRAME;
+    bool blank_frame_drawn = false;
+
+    const FrameBuffer* finished_frame = nullptr;
 };
-
-const uint CLOCKS_PER_HBLANK = 204; /* Mode 0 */
-const uint CLOCKS_PER_SCANLINE_OAM = 80; /* Mode 2 */
-const uint CLOCKS_PER_SCANLINE_VRAM = 172; /* Mode 3 */
-const uint CLOCKS_PER_SCANLINE =
-    (CLOCKS_PER_SCANLINE_OAM + CLOCKS_PER_SCANLINE_VRAM + CLOCKS_PER_HBLANK);
-
-const uint CLOCKS_PER_VBLANK = 4560; /* Mode 1 */
-const uint SCANLINES_PER_FRAME = 144;
-const uint CLOCKS_PER_FRAME = (CLOCKS_PER_SCANLINE * SCANLINES_PER_FRAME) + CLOCKS_PER_VBLANK;
\ No newline at end of file